@@ -0,0 +1,215 @@
+/**
+ * @file address_map.h
+ * @brief Sorted address map used by the SystemC interconnect models
+ *
+ * An AddressMap keeps a set of non-overlapping, inclusive address ranges
+ * [start, end], each with a value attached (typically a port index). The
+ * ranges are stored in a flat vector sorted by start address, so a lookup is
+ * a binary search over contiguous memory. The entry found last is cached,
+ * since consecutive accesses mostly go to the same range.
+ *
+ * For platforms whose map is known at compile time, StaticAddressMap decodes
+ * a constexpr table of AddressRange with a comparison tree the compiler
+ * builds from constants.
+ */
+
+#ifndef ADDRESS_MAP_H
+#define ADDRESS_MAP_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+namespace Gem5SystemC
+{
+
+template <typename T>
+class AddressMap
+{
+public:
+    struct Entry
+    {
+        uint64_t start;
+        uint64_t end;   // inclusive
+        T value;
+
+        bool contains(uint64_t addr) const {
+            return addr >= start && addr <= end;
+        }
+    };
+
+    /**
+     * Add the range [start, end]. Returns false and leaves the map
+     * untouched if the range is empty or overlaps an existing one.
+     */
+    bool insert(uint64_t start, uint64_t end, const T& value)
+    {
+        if (end < start) {
+            return false;
+        }
+        auto it = std::upper_bound(entries_.begin(), entries_.end(), start,
+            [](uint64_t addr, const Entry& e) { return addr < e.start; });
+        // the successor must start after us, the predecessor end before us
+        if (it != entries_.end() && it->start <= end) {
+            return false;
+        }
+        if (it != entries_.begin() && std::prev(it)->end >= start) {
+            return false;
+        }
+        entries_.insert(it, Entry{start, end, value});
+        lastHit = noHit;
+        return true;
+    }
+
+    /** Find the range containing addr, nullptr if there is none */
+    const Entry* find(uint64_t addr) const
+    {
+        if (lastHit != noHit && entries_[lastHit].contains(addr)) {
+            return &entries_[lastHit];
+        }
+        auto it = std::upper_bound(entries_.begin(), entries_.end(), addr,
+            [](uint64_t a, const Entry& e) { return a < e.start; });
+        if (it == entries_.begin()) {
+            return nullptr;
+        }
+        --it;
+        if (!it->contains(addr)) {
+            return nullptr;
+        }
+        lastHit = it - entries_.begin();
+        return &*it;
+    }
+
+    /**
+     * Bounds of the unmapped gap containing addr. Returns false if addr is
+     * covered by a range.
+     */
+    bool gap(uint64_t addr, uint64_t& start, uint64_t& end) const
+    {
+        auto it = std::upper_bound(entries_.begin(), entries_.end(), addr,
+            [](uint64_t a, const Entry& e) { return a < e.start; });
+        if (it != entries_.begin() && std::prev(it)->contains(addr)) {
+            return false;
+        }
+        start = it == entries_.begin() ? 0 : std::prev(it)->end + 1;
+        end = it == entries_.end() ? ~uint64_t(0) : it->start - 1;
+        return true;
+    }
+
+    const std::vector<Entry>& entries() const { return entries_; }
+    bool empty() const { return entries_.empty(); }
+    void clear() { entries_.clear(); lastHit = noHit; }
+
+private:
+    static constexpr size_t noHit = ~size_t(0);
+
+    std::vector<Entry> entries_;
+    mutable size_t lastHit = noHit;
+};
+
+/** A range of a StaticAddressMap, mapped to target */
+struct AddressRange
+{
+    uint64_t start;
+    uint64_t end;   // inclusive
+    unsigned target;
+
+    constexpr bool contains(uint64_t addr) const {
+        return addr >= start && addr <= end;
+    }
+};
+
+namespace detail
+{
+
+/** True if the ranges are non-empty, sorted by start and do not overlap */
+constexpr bool
+validAddressRanges(const AddressRange* ranges, size_t size)
+{
+    for (size_t i = 0; i < size; i++) {
+        if (ranges[i].end < ranges[i].start) {
+            return false;
+        }
+        if (i > 0 && ranges[i - 1].end >= ranges[i].start) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace detail
+
+/**
+ * Address decode for a map fixed at compile time. Map provides
+ *
+ *     static constexpr AddressRange ranges[] = { ... };
+ *
+ * sorted by start address. decode() is unrolled into a balanced tree of
+ * comparisons against the range bounds, so it needs no memory accesses
+ * besides the address itself. Returns -1 if no range matches.
+ */
+template <typename Map>
+class StaticAddressMap
+{
+public:
+    static constexpr size_t size =
+        sizeof(Map::ranges) / sizeof(Map::ranges[0]);
+
+    static_assert(size > 0, "empty address map");
+    static_assert(detail::validAddressRanges(Map::ranges, size),
+                  "address ranges must be sorted, non-empty and disjoint");
+
+    static int decode(uint64_t addr) { return decodeRange<0, size>(addr); }
+
+    /** The range containing addr, nullptr if there is none */
+    static const AddressRange* find(uint64_t addr)
+    {
+        return findRange<0, size>(addr);
+    }
+
+    /** Highest target index used by the map */
+    static constexpr unsigned maxTarget()
+    {
+        unsigned target = 0;
+        for (size_t i = 0; i < size; i++) {
+            target = std::max(target, Map::ranges[i].target);
+        }
+        return target;
+    }
+
+private:
+    template <size_t Lo, size_t Hi>
+    static int decodeRange(uint64_t addr)
+    {
+        if constexpr (Hi - Lo == 1) {
+            constexpr AddressRange range = Map::ranges[Lo];
+            return range.contains(addr) ? int(range.target) : -1;
+        } else {
+            constexpr size_t mid = Lo + (Hi - Lo) / 2;
+            if (addr < Map::ranges[mid].start) {
+                return decodeRange<Lo, mid>(addr);
+            }
+            return decodeRange<mid, Hi>(addr);
+        }
+    }
+
+    template <size_t Lo, size_t Hi>
+    static const AddressRange* findRange(uint64_t addr)
+    {
+        if constexpr (Hi - Lo == 1) {
+            return Map::ranges[Lo].contains(addr) ? &Map::ranges[Lo] : nullptr;
+        } else {
+            constexpr size_t mid = Lo + (Hi - Lo) / 2;
+            if (addr < Map::ranges[mid].start) {
+                return findRange<Lo, mid>(addr);
+            }
+            return findRange<mid, Hi>(addr);
+        }
+    }
+};
+
+} // namespace Gem5SystemC
+
+#endif
@@ -0,0 +1,148 @@
+/**
+ * @file amo_ext.h
+ * @brief TLM extension for atomic memory operations
+ *
+ * An AmoExtension turns a transaction into an atomic read-modify-write
+ * that the target executes as one operation, returning the old value in the
+ * data buffer. Loads with reservation and store-conditionals (LR/SC) are
+ * carried the same way. The command of the transaction is TLM_READ_COMMAND
+ * for AMOs and LR and TLM_WRITE_COMMAND for SC, so interconnects route and
+ * time them like ordinary accesses.
+ *
+ * A target that supports the extension sets executed; an initiator should
+ * check it, since a target unaware of the extension silently performs a
+ * plain read or write instead.
+ *
+ * Operands and memory are in host byte order, which matches the guest for
+ * the little-endian ISAs we run on little-endian hosts.
+ */
+
+#ifndef AMO_EXT_H
+#define AMO_EXT_H
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <systemc>
+#include <tlm>
+
+namespace Gem5SystemC
+{
+
+enum AmoOp : uint8_t
+{
+    AMO_SWAP,
+    AMO_ADD,
+    AMO_AND,
+    AMO_OR,
+    AMO_XOR,
+    AMO_MIN,                // signed
+    AMO_MAX,                // signed
+    AMO_MINU,
+    AMO_MAXU,
+    AMO_CAS,                // store operand if memory equals compare
+    AMO_FUNCTOR,            // apply functor to the memory in place
+    AMO_LOAD_RESERVED,
+    AMO_STORE_CONDITIONAL
+};
+
+class AmoExtension : public tlm::tlm_extension<AmoExtension>
+{
+public:
+    AmoOp op = AMO_SWAP;
+    uint64_t operand = 0;
+    uint64_t compare = 0;
+    /**
+     * Operation of AMO_FUNCTOR, modifies the memory pointed to. Used for
+     * gem5 AtomicOpFunctors, which do not expose their opcode.
+     */
+    std::function<void(uint8_t*)> functor;
+    /** LR/SC: identifies the hart/context holding the reservation */
+    uint64_t reservation_id = 0;
+
+    // set by the target
+    bool executed = false;
+    bool sc_success = false;
+
+    tlm::tlm_extension_base* clone() const override
+    {
+        return new AmoExtension(*this);
+    }
+
+    void copy_from(const tlm::tlm_extension_base& ext) override
+    {
+        *this = static_cast<const AmoExtension&>(ext);
+    }
+
+    bool is_reservation_op() const
+    {
+        return op == AMO_LOAD_RESERVED || op == AMO_STORE_CONDITIONAL;
+    }
+
+    /**
+     * Execute a read-modify-write op on len bytes of memory at mem, the
+     * old value is returned in data. len is at most 8 except for
+     * AMO_FUNCTOR. Not for LR/SC, which need the target's reservations.
+     */
+    void execute(uint8_t* mem, uint8_t* data, unsigned len)
+    {
+        if (op == AMO_FUNCTOR) {
+            std::memmove(data, mem, len);
+            functor(mem);
+            executed = true;
+            return;
+        }
+        sc_assert(len <= 8 && !is_reservation_op());
+
+        uint64_t old = 0;
+        std::memcpy(&old, mem, len);
+        uint64_t value = old;
+        switch (op) {
+          case AMO_SWAP: value = operand; break;
+          case AMO_ADD: value = old + operand; break;
+          case AMO_AND: value = old & operand; break;
+          case AMO_OR: value = old | operand; break;
+          case AMO_XOR: value = old ^ operand; break;
+          case AMO_MIN:
+            value = sign_extend(operand, len) < sign_extend(old, len)
+                ? operand : old;
+            break;
+          case AMO_MAX:
+            value = sign_extend(operand, len) > sign_extend(old, len)
+                ? operand : old;
+            break;
+          case AMO_MINU:
+            value = truncate(operand, len) < old ? operand : old;
+            break;
+          case AMO_MAXU:
+            value = truncate(operand, len) > old ? operand : old;
+            break;
+          case AMO_CAS:
+            if (old == truncate(compare, len)) {
+                value = operand;
+            }
+            break;
+          default:
+            break;
+        }
+        std::memcpy(mem, &value, len);
+        std::memcpy(data, &old, len);
+        executed = true;
+    }
+
+private:
+    static uint64_t truncate(uint64_t v, unsigned len)
+    {
+        return len >= 8 ? v : v & ((uint64_t(1) << (len * 8)) - 1);
+    }
+
+    static int64_t sign_extend(uint64_t v, unsigned len)
+    {
+        unsigned shift = 64 - len * 8;
+        return int64_t(v << shift) >> shift;
+    }
+};
+
+} // namespace Gem5SystemC
+
+#endif
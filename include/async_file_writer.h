@@ -0,0 +1,134 @@
+/**
+ * @file async_file_writer.h
+ * @brief Append-only file writer with a background thread
+ *
+ * write() only appends to an in-memory buffer. A full buffer is handed to
+ * a background thread that writes it to the file while the caller fills
+ * the other buffer, so the simulation thread does not wait for the disk
+ * unless it produces data faster than the disk takes it.
+ *
+ * This header depends on the C++ standard library only.
+ */
+
+#ifndef ASYNC_FILE_WRITER_H
+#define ASYNC_FILE_WRITER_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace Gem5SystemC
+{
+
+class AsyncFileWriter
+{
+public:
+    explicit AsyncFileWriter(size_t buffer_bytes = 1 << 20)
+        : capacity(buffer_bytes)
+    {
+        front.reserve(capacity);
+        back.reserve(capacity);
+    }
+
+    ~AsyncFileWriter() { close(); }
+
+    AsyncFileWriter(const AsyncFileWriter&) = delete;
+    AsyncFileWriter& operator=(const AsyncFileWriter&) = delete;
+
+    /** Start writing to path, truncating it. Returns false on error */
+    bool open(const std::string& path)
+    {
+        close();
+        file = std::fopen(path.c_str(), "wb");
+        if (!file) {
+            return false;
+        }
+        failed = false;
+        stop = false;
+        thread = std::thread(&AsyncFileWriter::run, this);
+        return true;
+    }
+
+    bool is_open() const { return file != nullptr; }
+
+    void write(const void* data, size_t len)
+    {
+        front.append(static_cast<const char*>(data), len);
+        if (front.size() >= capacity) {
+            hand_over();
+        }
+    }
+
+    /**
+     * Write out everything written so far and close the file. Returns
+     * false if any write failed.
+     */
+    bool close()
+    {
+        if (!file) {
+            return !failed;
+        }
+        hand_over();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        cv.notify_all();
+        thread.join();
+        failed |= std::fclose(file) != 0;
+        file = nullptr;
+        return !failed;
+    }
+
+private:
+    /** Give the front buffer to the thread, once it is done with back */
+    void hand_over()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [this] { return !pending; });
+        front.swap(back);
+        pending = true;
+        lock.unlock();
+        cv.notify_all();
+        front.clear();
+    }
+
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            cv.wait(lock, [this] { return pending || stop; });
+            if (pending) {
+                // back is ours until pending is cleared
+                lock.unlock();
+                bool ok = std::fwrite(back.data(), 1, back.size(), file) ==
+                          back.size();
+                lock.lock();
+                failed |= !ok;
+                pending = false;
+                cv.notify_all();
+            } else {
+                return;
+            }
+        }
+    }
+
+    const size_t capacity;
+    std::string front;          // filled by write()
+    std::string back;           // being written by the thread
+    std::FILE* file = nullptr;
+    bool failed = false;
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool pending = false;       // back holds data to write
+    bool stop = false;
+    std::thread thread;
+};
+
+} // namespace Gem5SystemC
+
+#endif
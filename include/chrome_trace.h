@@ -0,0 +1,186 @@
+/**
+ * @file chrome_trace.h
+ * @brief Timeline of the transactions crossing the gem5/SystemC boundary
+ *
+ * When open, the ports record every transaction crossing the boundary in
+ * the Chrome trace-event JSON format, which chrome://tracing and Perfetto
+ * display as a timeline. Each port is a process with a request and a
+ * response track per socket: the request track shows the request channel
+ * (request received until END_REQ) and the response track the response
+ * channel (BEGIN_RESP until the response is accepted), where back-pressure
+ * shows up as long spans. The service time in between is an async span,
+ * since several transactions of a socket can be outstanding. Activations
+ * of the gem5 event loop are instant events carrying the number of events
+ * serviced.
+ *
+ * Timestamps are simulated time. Events are formatted into a buffer that
+ * an AsyncFileWriter writes out in the background.
+ *
+ * Open the trace before the simulation starts and close it when it ends
+ * (Gem5SimControl::run() does this).
+ */
+
+#ifndef CHROME_TRACE_H
+#define CHROME_TRACE_H
+
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include "async_file_writer.h"
+
+namespace Gem5SystemC
+{
+
+class ChromeTrace
+{
+public:
+    /** The open trace, nullptr when tracing is off */
+    static ChromeTrace* get() { return instance; }
+
+    /** Start tracing to path. Returns false if it cannot be created */
+    static bool open(const std::string& path, size_t buffer_bytes = 1 << 22)
+    {
+        close();
+        ChromeTrace* trace = new ChromeTrace(buffer_bytes);
+        if (!trace->writer.open(path)) {
+            delete trace;
+            return false;
+        }
+        trace->writer.write("{\"traceEvents\":[\n", 17);
+        instance = trace;
+        return true;
+    }
+
+    /** Finish the file, returns false if writing it failed */
+    static bool close()
+    {
+        if (!instance) {
+            return true;
+        }
+        instance->writer.write("]}\n", 3);
+        bool ok = instance->writer.close();
+        delete instance;
+        instance = nullptr;
+        return ok;
+    }
+
+    /** A new process (a row group in the viewer), returns its pid */
+    uint32_t addProcess(const std::string& name)
+    {
+        uint32_t pid = ++processes;
+        event("{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":%" PRIu32
+              ",\"args\":{\"name\":\"%s\"}}",
+              pid, escape(name).c_str());
+        return pid;
+    }
+
+    void nameTrack(uint32_t pid, uint32_t tid, const std::string& name)
+    {
+        event("{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%" PRIu32
+              ",\"tid\":%" PRIu32 ",\"args\":{\"name\":\"%s\"}}",
+              pid, tid, escape(name).c_str());
+    }
+
+    /** A span of [start, end) ps on a track, spans of a track must nest */
+    void span(uint32_t pid, uint32_t tid, const char* name, uint64_t start,
+              uint64_t end, uint64_t addr)
+    {
+        event("{\"ph\":\"X\",\"name\":\"%s\",\"pid\":%" PRIu32
+              ",\"tid\":%" PRIu32 ",\"ts\":%s,\"dur\":%s"
+              ",\"args\":{\"addr\":\"0x%" PRIx64 "\"}}",
+              name, pid, tid, us(start).c_str(), us(end - start).c_str(),
+              addr);
+    }
+
+    /** A span of [start, end) ps that may overlap others of the track */
+    void asyncSpan(uint32_t pid, uint32_t tid, const char* name,
+                   uint64_t start, uint64_t end, uint64_t addr)
+    {
+        uint64_t id = ++asyncIds;
+        event("{\"ph\":\"b\",\"cat\":\"txn\",\"id\":%" PRIu64
+              ",\"name\":\"%s\",\"pid\":%" PRIu32 ",\"tid\":%" PRIu32
+              ",\"ts\":%s,\"args\":{\"addr\":\"0x%" PRIx64 "\"}}",
+              id, name, pid, tid, us(start).c_str(), addr);
+        event("{\"ph\":\"e\",\"cat\":\"txn\",\"id\":%" PRIu64
+              ",\"name\":\"%s\",\"pid\":%" PRIu32 ",\"tid\":%" PRIu32
+              ",\"ts\":%s}",
+              id, name, pid, tid, us(end).c_str());
+    }
+
+    /** An instant event at ts ps with a count */
+    void instant(uint32_t pid, uint32_t tid, const char* name, uint64_t ts,
+                 uint64_t count)
+    {
+        event("{\"ph\":\"i\",\"s\":\"t\",\"name\":\"%s\",\"pid\":%" PRIu32
+              ",\"tid\":%" PRIu32 ",\"ts\":%s,\"args\":{\"count\":%" PRIu64
+              "}}",
+              name, pid, tid, us(ts).c_str(), count);
+    }
+
+private:
+    explicit ChromeTrace(size_t buffer_bytes)
+        : writer(buffer_bytes)
+    {}
+
+    template <typename... Args>
+    void event(const char* format, Args... args)
+    {
+        char buf[512];
+        int len = std::snprintf(buf, sizeof(buf), format, args...);
+        if (len < 0) {
+            return;
+        }
+        if (len >= int(sizeof(buf))) {
+            // only names can make an event this long
+            std::string big(len + 1, '\0');
+            std::snprintf(&big[0], big.size(), format, args...);
+            big.resize(len);
+            separate();
+            writer.write(big.data(), big.size());
+            return;
+        }
+        separate();
+        writer.write(buf, len);
+    }
+
+    void separate()
+    {
+        if (events++) {
+            writer.write(",\n", 2);
+        }
+    }
+
+    /** ps as a decimal number of us, the unit of the format */
+    static std::string us(uint64_t ps)
+    {
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "%" PRIu64 ".%06" PRIu64,
+                      ps / 1000000, ps % 1000000);
+        return buf;
+    }
+
+    static std::string escape(const std::string& s)
+    {
+        std::string out;
+        for (char c : s) {
+            if (c == '"' || c == '\\') {
+                out += '\\';
+            }
+            out += c;
+        }
+        return out;
+    }
+
+    inline static ChromeTrace* instance = nullptr;
+
+    AsyncFileWriter writer;
+    uint64_t events = 0;
+    uint32_t processes = 0;
+    uint64_t asyncIds = 0;
+};
+
+} // namespace Gem5SystemC
+
+#endif
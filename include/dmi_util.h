@@ -0,0 +1,39 @@
+/**
+ * @file dmi_util.h
+ * @brief Helpers for forwarding DMI through the SystemC interconnect models
+ */
+
+#ifndef DMI_UTIL_H
+#define DMI_UTIL_H
+
+#include <cstdint>
+#include <tlm>
+
+namespace Gem5SystemC
+{
+
+/**
+ * Restrict a DMI descriptor to [start, end]. An interconnect must not hand
+ * out more than the address range it routes to the target, so the region
+ * returned by the target is clipped to the range it was decoded from. The
+ * same applies to a denied region. The interconnect models do not
+ * translate addresses, so the range is already global.
+ */
+inline void
+clip_dmi(tlm::tlm_dmi& dmi, uint64_t start, uint64_t end)
+{
+    if (dmi.get_start_address() < start) {
+        if (dmi.get_dmi_ptr()) {
+            dmi.set_dmi_ptr(dmi.get_dmi_ptr() +
+                            (start - dmi.get_start_address()));
+        }
+        dmi.set_start_address(start);
+    }
+    if (dmi.get_end_address() > end) {
+        dmi.set_end_address(end);
+    }
+}
+
+} // namespace Gem5SystemC
+
+#endif
@@ -0,0 +1,300 @@
+/**
+ * @file dram_timing.h
+ * @brief Analytical DRAM timing model
+ *
+ * A DramTiming sits in front of a storage target (e.g. SparseMemory) and
+ * adds DRAM timing to every access. The latency is computed in closed form
+ * per request from the state of the addressed bank and channel, nothing
+ * is simulated cycle by cycle and no events are scheduled, so the cost per
+ * access is a handful of integer operations.
+ *
+ * The model covers:
+ *  - address interleaving: burst-sized chunks are spread over the channels,
+ *    then columns, banks, ranks and rows (RoRaBaCoCh), with optional XOR
+ *    hashing of the bank index with the row
+ *  - per bank open-page policy: row hit (tCL), miss on a precharged bank
+ *    (tRCD + tCL), conflict (tRP + tRCD + tCL, precharge after tRAS and
+ *    the write recovery tWR)
+ *  - column commands to an open row pipelined every burst (tCCD = tBURST)
+ *  - activates per rank spaced by tRRD, at most four per tFAW window
+ *  - one data bus per channel, bursts are serialised on it
+ *  - per rank refresh every tREFI for tRFC, which closes all rows
+ *
+ * Data is moved by forwarding the transaction to isock with b_transport;
+ * the delay the storage adds is ignored. nb_transport is answered in a
+ * single call with BEGIN_RESP. DMI is refused since it would bypass the
+ * timing, debug accesses are forwarded untimed.
+ */
+
+#ifndef DRAM_TIMING_H
+#define DRAM_TIMING_H
+
+#include <tlm_utils/simple_initiator_socket.h>
+#include <tlm_utils/simple_target_socket.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <systemc>
+#include <vector>
+
+namespace Gem5SystemC
+{
+
+/**
+ * Organisation and timing of a DramTiming. The defaults are a DDR4-2400
+ * x64 channel with 16 banks per rank.
+ */
+struct DramTimingConfig
+{
+    unsigned channels = 1;
+    unsigned ranks = 1;
+    unsigned banks = 16;        // per rank
+    unsigned row_size = 8192;   // bytes per row of a bank
+    unsigned burst_size = 64;   // bytes per burst, the interleaving unit
+    bool bank_xor = true;       // bank index ^= row, spreads row conflicts
+
+    sc_core::sc_time tCL = sc_core::sc_time(14.16, sc_core::SC_NS);
+    sc_core::sc_time tRCD = sc_core::sc_time(14.16, sc_core::SC_NS);
+    sc_core::sc_time tRP = sc_core::sc_time(14.16, sc_core::SC_NS);
+    sc_core::sc_time tRAS = sc_core::sc_time(32.0, sc_core::SC_NS);
+    sc_core::sc_time tWR = sc_core::sc_time(15.0, sc_core::SC_NS);
+    sc_core::sc_time tBURST = sc_core::sc_time(3.333, sc_core::SC_NS);
+    sc_core::sc_time tRRD = sc_core::sc_time(4.9, sc_core::SC_NS);
+    sc_core::sc_time tFAW = sc_core::sc_time(30.0, sc_core::SC_NS);
+    sc_core::sc_time tRFC = sc_core::sc_time(350.0, sc_core::SC_NS);
+    sc_core::sc_time tREFI = sc_core::sc_time(7.8, sc_core::SC_US);
+    /** Controller latency added to every access */
+    sc_core::sc_time frontend_latency = sc_core::sc_time(10.0, sc_core::SC_NS);
+};
+
+struct DramTimingStats
+{
+    uint64_t reads = 0;
+    uint64_t writes = 0;
+    uint64_t bytes = 0;
+    uint64_t row_hits = 0;
+    uint64_t row_misses = 0;      // bank was precharged
+    uint64_t row_conflicts = 0;   // another row was open
+    uint64_t refresh_stalls = 0;  // access waited for a refresh
+};
+
+class DramTiming : public sc_core::sc_module
+{
+public:
+    tlm_utils::simple_target_socket<DramTiming> tsock;
+    // to the storage
+    tlm_utils::simple_initiator_socket<DramTiming> isock;
+
+    DramTiming(sc_core::sc_module_name,
+               const DramTimingConfig& config_ = DramTimingConfig())
+        : tsock("tsock"),
+          isock("isock"),
+          config(config_),
+          columns(config_.row_size / std::max(config_.burst_size, 1u)),
+          bank_state(config_.channels * config_.ranks * config_.banks),
+          rank_state(config_.channels * config_.ranks),
+          channel_state(config_.channels)
+    {
+        if (config.channels == 0 || config.ranks == 0 || config.banks == 0 ||
+            config.burst_size == 0 || columns == 0) {
+            SC_REPORT_FATAL(name(), "Invalid DRAM organisation");
+        }
+        tsock.register_b_transport(this, &DramTiming::b_transport);
+        tsock.register_nb_transport_fw(this, &DramTiming::nb_transport_fw);
+        tsock.register_transport_dbg(this, &DramTiming::transport_dbg);
+        tsock.register_get_direct_mem_ptr(this,
+                                          &DramTiming::get_direct_mem_ptr);
+    }
+
+    const DramTimingStats& stats() const { return dram_stats; }
+
+    /**
+     * Time at which the data of an access arriving at arrival has been
+     * transferred, and update the bank and channel state. Accesses larger
+     * than a burst are split at burst boundaries. Used by the transport
+     * callbacks; public so that traffic can be timed without a payload.
+     */
+    sc_core::sc_time access(uint64_t addr, unsigned length, bool write,
+                            sc_core::sc_time arrival)
+    {
+        uint64_t end = addr + std::max(length, 1u);
+
+        if (write) {
+            dram_stats.writes++;
+        } else {
+            dram_stats.reads++;
+        }
+        dram_stats.bytes += length;
+
+        sc_core::sc_time t = arrival + config.frontend_latency;
+        sc_core::sc_time done = t;
+        for (uint64_t chunk = addr / config.burst_size;
+             chunk * config.burst_size < end; chunk++) {
+            done = std::max(done, burst(chunk, t, write));
+        }
+        return done;
+    }
+
+private:
+    struct Bank
+    {
+        int64_t open_row = -1;
+        sc_core::sc_time activated;     // last ACT
+        sc_core::sc_time col_ready;     // next column command
+        sc_core::sc_time pre_ready;     // earliest precharge (tWR)
+    };
+
+    struct Rank
+    {
+        uint64_t refresh_epoch = 0;     // refreshes seen by this rank
+        sc_core::sc_time acts[4];       // last four ACTs, for tFAW
+        uint64_t num_acts = 0;
+    };
+
+    struct Channel
+    {
+        sc_core::sc_time bus_free;
+    };
+
+    void b_transport(tlm::tlm_generic_payload& trans, sc_core::sc_time& delay)
+    {
+        sc_core::sc_time now = sc_core::sc_time_stamp();
+        sc_core::sc_time done = access(trans, now + delay);
+
+        sc_core::sc_time storage_delay = sc_core::SC_ZERO_TIME;
+        isock->b_transport(trans, storage_delay);
+        trans.set_dmi_allowed(false);
+        delay = done - now;
+    }
+
+    tlm::tlm_sync_enum nb_transport_fw(tlm::tlm_generic_payload& trans,
+                                       tlm::tlm_phase& phase,
+                                       sc_core::sc_time& delay)
+    {
+        if (phase == tlm::BEGIN_REQ) {
+            b_transport(trans, delay);
+            phase = tlm::BEGIN_RESP;
+            return tlm::TLM_UPDATED;
+        }
+        if (phase == tlm::END_RESP) {
+            return tlm::TLM_COMPLETED;
+        }
+        SC_REPORT_FATAL(name(), "Illegal transaction phase");
+        return tlm::TLM_COMPLETED;
+    }
+
+    unsigned transport_dbg(tlm::tlm_generic_payload& trans)
+    {
+        return isock->transport_dbg(trans);
+    }
+
+    bool get_direct_mem_ptr(tlm::tlm_generic_payload&, tlm::tlm_dmi&)
+    {
+        return false;
+    }
+
+    sc_core::sc_time access(tlm::tlm_generic_payload& trans,
+                            sc_core::sc_time arrival)
+    {
+        return access(trans.get_address(), trans.get_data_length(),
+                      trans.is_write(), arrival);
+    }
+
+    /** Timing of one burst, returns the end of its data transfer */
+    sc_core::sc_time burst(uint64_t chunk, sc_core::sc_time t, bool write)
+    {
+        // RoRaBaCoCh
+        unsigned channel = chunk % config.channels;
+        chunk /= config.channels;
+        chunk /= columns;
+        unsigned bank = chunk % config.banks;
+        chunk /= config.banks;
+        unsigned rank = chunk % config.ranks;
+        int64_t row = chunk / config.ranks;
+        if (config.bank_xor) {
+            bank = (bank ^ uint64_t(row)) % config.banks;
+        }
+
+        unsigned rank_id = channel * config.ranks + rank;
+        Bank& b = bank_state[rank_id * config.banks + bank];
+        Rank& r = rank_state[rank_id];
+        Channel& c = channel_state[channel];
+        t = refresh(rank_id, t);
+
+        sc_core::sc_time col = std::max(t, b.col_ready);
+        if (b.open_row == row) {
+            dram_stats.row_hits++;
+        } else {
+            sc_core::sc_time act = t;
+            if (b.open_row < 0) {
+                dram_stats.row_misses++;
+            } else {
+                dram_stats.row_conflicts++;
+                sc_core::sc_time pre = std::max({t, b.activated + config.tRAS,
+                                                 b.pre_ready});
+                act = pre + config.tRP;
+            }
+            if (r.num_acts > 0) {
+                act = std::max(act, r.acts[(r.num_acts - 1) % 4] +
+                                    config.tRRD);
+            }
+            if (r.num_acts >= 4) {
+                act = std::max(act, r.acts[r.num_acts % 4] + config.tFAW);
+            }
+            r.acts[r.num_acts++ % 4] = act;
+            b.open_row = row;
+            b.activated = act;
+            col = std::max(col, act + config.tRCD);
+        }
+        // the data must find the channel bus free
+        if (c.bus_free > col + config.tCL) {
+            col = c.bus_free - config.tCL;
+        }
+        sc_core::sc_time data_end = col + config.tCL + config.tBURST;
+        c.bus_free = data_end;
+        b.col_ready = col + config.tBURST;
+        if (write) {
+            b.pre_ready = std::max(b.pre_ready, data_end + config.tWR);
+        }
+        return data_end;
+    }
+
+    /**
+     * Delay t out of a refresh of the rank. Refreshes happen every tREFI
+     * and take tRFC, the first refresh closes the rows opened before it.
+     */
+    sc_core::sc_time refresh(unsigned rank_id, sc_core::sc_time t)
+    {
+        uint64_t interval = config.tREFI.value();
+        if (interval == 0) {
+            return t;
+        }
+        uint64_t epoch = t.value() / interval;
+        Rank& r = rank_state[rank_id];
+        if (epoch > r.refresh_epoch) {
+            r.refresh_epoch = epoch;
+            for (unsigned i = 0; i < config.banks; i++) {
+                bank_state[rank_id * config.banks + i].open_row = -1;
+            }
+        }
+        sc_core::sc_time refresh_end = sc_core::sc_time::from_value(
+            epoch * interval) + config.tRFC;
+        if (epoch > 0 && t < refresh_end) {
+            dram_stats.refresh_stalls++;
+            return refresh_end;
+        }
+        return t;
+    }
+
+    DramTimingConfig config;
+    const unsigned columns;     // bursts per row
+
+    std::vector<Bank> bank_state;
+    std::vector<Rank> rank_state;
+    std::vector<Channel> channel_state;
+    DramTimingStats dram_stats;
+};
+
+} // namespace Gem5SystemC
+
+#endif
@@ -8,8 +8,8 @@
 #include "sim_control.hh"
 #include "slave_transactor.hh"
 #include "txn_router.h"
-#include "memory.h"
 #include "simple_bus.h"
+#include "sparse_memory.h"
 
 namespace Gem5SystemC{
 
@@ -46,19 +46,50 @@ class Gem5Wrapper
         TxnRouter* createTxnRouter(uint32_t id, sc_core::sc_module_name name,
                             uint64_t mem_start_addr,
                             uint64_t mem_size,
-                            bool debug);
+                            bool debug,
+                            const TxnRouterConfig& config = TxnRouterConfig());
 
         Transactor* getTransactor(uint32_t transactor_id = 0);
 
-        SimpleBus<2,1>* createSimpleBus(uint64_t mem_start_addr,
-                                        uint64_t mem_end_addr);
+        /**
+         * Create the SimpleBus singleton with the memory mapped to its
+         * first target socket. mem_end_addr is inclusive.
+         */
+        SimpleBus* createSimpleBus(uint64_t mem_start_addr,
+                                   uint64_t mem_end_addr,
+                                   unsigned nr_of_initiators = 2,
+                                   unsigned nr_of_targets = 1,
+                                   const SimpleBusConfig& config =
+                                       SimpleBusConfig());
+
+        /** Create the memory singleton, bound with bindBus2Memory() */
+        SparseMemory* createMemory(uint64_t mem_start_addr,
+                                   uint64_t mem_size,
+                                   const SparseMemoryConfig& config =
+                                       SparseMemoryConfig());
 
         void init(); // TODO
         void bindSimControl2Transactor();
         void bindTxnRouter2Transactor(uint32_t txn_id, uint32_t socket_id,
                                     uint32_t transactor_id = 0);
         void bindTxnRouter2Bus(uint32_t txn_id, uint32_t socket_id);
-        void bindBus2Memory(); // TODO
+        void bindBus2Memory(uint32_t socket_id = 0);
+
+        /** Save or restore the memory contents, e.g. with a checkpoint */
+        bool saveMemorySnapshot(const std::string& path);
+        bool restoreMemorySnapshot(const std::string& path);
+
+        /**
+         * Write the loadable segments of a program image (ELF or any other
+         * format the gem5 loader knows) at path into the memory directly,
+         * shifted by offset. Segments outside the memory are written
+         * through gem5's functional path instead, as the gem5 workload
+         * loader would. Use it in place of loading by the workload, after
+         * createSimControl. Returns false if the image cannot be read.
+         */
+        bool preloadImage(const std::string& path, uint64_t offset = 0);
+        /** Like preloadImage, for a raw binary placed at base */
+        bool preloadRawImage(const std::string& path, uint64_t base);
 
     protected:
         static Gem5Wrapper* instance;
@@ -69,12 +100,16 @@ class Gem5Wrapper
         // a map to store txn_routers
         std::map<uint32_t, TxnRouter*> txn_routers;
 
-        SimpleBus<2,1>* busInstance = nullptr;
+        SimpleBus* busInstance = nullptr;
         bool isBusCreated = false;
 
+        SparseMemory* memInstance = nullptr;
+
 
 
     private:
+        bool preload(const std::string& path, bool raw, uint64_t offset);
+
         // make sure that simControl only be binded once
         bool simControlBinded = false;
 
@@ -0,0 +1,171 @@
+/**
+ * @file host_time.h
+ * @brief Host CPU time spent in each part of the co-simulation
+ *
+ * A HostTimeScope charges the host time until it ends to a component.
+ * Scopes nest: an inner scope pauses the outer one, so every cycle is
+ * charged to exactly one component, the innermost, and models called from
+ * an instrumented callback are charged to it. Time outside any scope is
+ * the SystemC kernel and the models that are not instrumented.
+ *
+ * Accounting is selected at compile time, define HOST_TIME_ACCOUNTING for
+ * the whole build. Without it scopes compile to nothing and report() only
+ * prints the total host time and the simulation speed. With it, time is
+ * read from the TSC where available (two reads per scope), and converted
+ * to seconds with the TSC rate measured over the run.
+ *
+ * A scope must not span a wait(): the time other processes run meanwhile
+ * would be charged to it. The b_transport of the interconnects may be
+ * called from threads whose targets wait, so it is not instrumented. The
+ * b_transport SCSlavePort::recvAtomic() issues is, as gem5 events run in
+ * the eventLoop method process of Module, where targets cannot wait.
+ */
+
+#ifndef HOST_TIME_H
+#define HOST_TIME_H
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <ostream>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace Gem5SystemC
+{
+
+enum HostTimeComponent
+{
+    HOST_TIME_OTHER,            // outside any scope
+    HOST_TIME_GEM5_EVENTS,      // gem5 serviceOne()
+    HOST_TIME_SLAVE_PORT,       // SCSlavePort callbacks
+    HOST_TIME_MASTER_PORT,      // SCMasterPort callbacks
+    HOST_TIME_INTERCONNECT,     // TxnRouter and SimpleBus
+    HOST_TIME_NUM_COMPONENTS
+};
+
+class HostTime
+{
+public:
+    static uint64_t now()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    static HostTime& get()
+    {
+        static HostTime host_time;
+        return host_time;
+    }
+
+    /** Start measuring, clears what was measured before */
+    void start()
+    {
+        for (auto& c : cycles) {
+            c = 0;
+        }
+        current = HOST_TIME_OTHER;
+        startWall = std::chrono::steady_clock::now();
+        startCycles = since = now();
+    }
+
+    /** Make c the current component, returns the previous one */
+    HostTimeComponent enter(HostTimeComponent c)
+    {
+        uint64_t t = now();
+        cycles[current] += t - since;
+        since = t;
+        HostTimeComponent previous = current;
+        current = c;
+        return previous;
+    }
+
+    /** Host seconds since start() */
+    double elapsed() const
+    {
+        return std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - startWall).count();
+    }
+
+    /**
+     * Print the host time and the simulation speed for sim_ticks simulated
+     * since start(), with HOST_TIME_ACCOUNTING also the time per component
+     */
+    void report(std::ostream& os, uint64_t sim_ticks)
+    {
+        double wall = elapsed();
+        char line[128];
+        std::snprintf(line, sizeof(line),
+                      "Host time %.3f s, %.4g simulated ticks per host s\n",
+                      wall, wall > 0 ? sim_ticks / wall : 0.0);
+        os << line;
+
+#ifdef HOST_TIME_ACCOUNTING
+        enter(current);
+        uint64_t total = now() - startCycles;
+        double per_cycle = total ? wall / total : 0;
+
+        static const char* names[HOST_TIME_NUM_COMPONENTS] = {
+            "SystemC kernel and other models",
+            "gem5 events",
+            "SCSlavePort",
+            "SCMasterPort",
+            "TxnRouter and SimpleBus"
+        };
+        for (int c = 0; c < HOST_TIME_NUM_COMPONENTS; c++) {
+            std::snprintf(line, sizeof(line), "  %-32s %10.3f s %5.1f%%\n",
+                          names[c], cycles[c] * per_cycle,
+                          total ? 100.0 * cycles[c] / total : 0.0);
+            os << line;
+        }
+#endif
+    }
+
+private:
+    HostTime() { start(); }
+
+    uint64_t cycles[HOST_TIME_NUM_COMPONENTS];
+    HostTimeComponent current = HOST_TIME_OTHER;
+    uint64_t since = 0;
+    uint64_t startCycles = 0;
+    std::chrono::steady_clock::time_point startWall;
+};
+
+#ifdef HOST_TIME_ACCOUNTING
+/** Charge the host time until the end of the scope to a component */
+class HostTimeScope
+{
+public:
+    explicit HostTimeScope(HostTimeComponent c)
+        : previous(HostTime::get().enter(c))
+    {}
+
+    ~HostTimeScope() { HostTime::get().enter(previous); }
+
+    HostTimeScope(const HostTimeScope&) = delete;
+    HostTimeScope& operator=(const HostTimeScope&) = delete;
+
+private:
+    HostTimeComponent previous;
+};
+#else
+class HostTimeScope
+{
+public:
+    explicit HostTimeScope(HostTimeComponent) {}
+
+    HostTimeScope(const HostTimeScope&) = delete;
+    HostTimeScope& operator=(const HostTimeScope&) = delete;
+};
+#endif
+
+} // namespace Gem5SystemC
+
+#endif
@@ -0,0 +1,204 @@
+/**
+ * @file req_trace.h
+ * @brief Compact binary trace of the requests gem5 sends to SystemC
+ *
+ * SCSlavePort can capture every request it accepts from gem5 (see
+ * Gem5SlaveTransactor_Multi::setRequestCapture) so the memory traffic of a
+ * full system run can be replayed against SystemC memory models without
+ * gem5. Records are delta encoded against the previous record and packed
+ * as LEB128 varints, a typical record takes 5 to 8 bytes:
+ *
+ *   varint  tick - previous tick
+ *   varint  socket << 2 | command (ReqTraceCommand)
+ *   varint  requestor id
+ *   varint  zigzag(addr - previous addr)
+ *   varint  size
+ *
+ * after an 8 byte magic. Records are written by an AsyncFileWriter, off
+ * the simulation thread. ReqTraceReader reads them back (see
+ * util/req_trace_decode.cc).
+ *
+ * This header depends on the C++ standard library only, so replay tools
+ * and the decoder can be built without SystemC and gem5.
+ */
+
+#ifndef REQ_TRACE_H
+#define REQ_TRACE_H
+
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include "async_file_writer.h"
+
+namespace Gem5SystemC
+{
+
+enum ReqTraceCommand : uint8_t
+{
+    REQ_TRACE_READ,
+    REQ_TRACE_WRITE,
+    REQ_TRACE_ATOMIC,       // reads and writes, e.g. swaps and AMOs
+    REQ_TRACE_OTHER
+};
+
+struct ReqTraceRecord
+{
+    uint64_t tick;
+    uint64_t addr;
+    uint32_t socket;
+    uint32_t requestor;
+    uint32_t size;
+    uint8_t command;        // ReqTraceCommand
+};
+
+class ReqTraceWriter
+{
+public:
+    explicit ReqTraceWriter(size_t buffer_bytes = 1 << 22)
+        : writer(buffer_bytes)
+    {}
+
+    /** Start a trace at path. Returns false if it cannot be created */
+    bool open(const std::string& path)
+    {
+        if (!writer.open(path)) {
+            return false;
+        }
+        writer.write(fileMagic, sizeof(fileMagic));
+        lastTick = 0;
+        lastAddr = 0;
+        count = 0;
+        return true;
+    }
+
+    bool is_open() const { return writer.is_open(); }
+
+    void record(const ReqTraceRecord& r)
+    {
+        uint8_t buf[5 * 10];
+        uint8_t* p = buf;
+        p = put(p, r.tick - lastTick);
+        p = put(p, uint64_t(r.socket) << 2 | (r.command & 3));
+        p = put(p, r.requestor);
+        int64_t delta = int64_t(r.addr - lastAddr);
+        p = put(p, (uint64_t(delta) << 1) ^ uint64_t(delta >> 63));
+        p = put(p, r.size);
+        writer.write(buf, p - buf);
+        lastTick = r.tick;
+        lastAddr = r.addr;
+        count++;
+    }
+
+    uint64_t recorded() const { return count; }
+
+    /** Write out the trace and close it. Returns false on error */
+    bool close() { return writer.close(); }
+
+private:
+    static uint8_t* put(uint8_t* p, uint64_t v)
+    {
+        while (v >= 0x80) {
+            *p++ = uint8_t(v) | 0x80;
+            v >>= 7;
+        }
+        *p++ = uint8_t(v);
+        return p;
+    }
+
+    friend class ReqTraceReader;
+    static constexpr char fileMagic[8] = {'R','E','Q','T','R','C','0','1'};
+
+    AsyncFileWriter writer;
+    uint64_t lastTick = 0;
+    uint64_t lastAddr = 0;
+    uint64_t count = 0;
+};
+
+class ReqTraceReader
+{
+public:
+    /** Checks the magic, see valid() */
+    explicit ReqTraceReader(std::istream& in_)
+        : in(in_)
+    {
+        char magic[sizeof(ReqTraceWriter::fileMagic)];
+        ok = bool(in.read(magic, sizeof(magic))) &&
+             std::memcmp(magic, ReqTraceWriter::fileMagic,
+                         sizeof(magic)) == 0;
+    }
+
+    /** False if the file is not a trace or a record was truncated */
+    bool valid() const { return ok; }
+
+    /** Read the next record, false at the end of the trace or on error */
+    bool next(ReqTraceRecord& r)
+    {
+        if (!ok || in.peek() == std::istream::traits_type::eof()) {
+            return false;
+        }
+        uint64_t tick_delta, socket_command, requestor, zigzag, size;
+        if (!get(tick_delta) || !get(socket_command) || !get(requestor) ||
+            !get(zigzag) || !get(size)) {
+            ok = false;
+            return false;
+        }
+        int64_t delta = int64_t(zigzag >> 1) ^ -int64_t(zigzag & 1);
+        tick += tick_delta;
+        addr += uint64_t(delta);
+        r.tick = tick;
+        r.addr = addr;
+        r.socket = uint32_t(socket_command >> 2);
+        r.command = uint8_t(socket_command & 3);
+        r.requestor = uint32_t(requestor);
+        r.size = uint32_t(size);
+        return true;
+    }
+
+    /** Decode a trace into one line of text per record */
+    static bool decode(std::istream& in, std::ostream& out)
+    {
+        static const char* const commandNames[] = { "R", "W", "A", "-" };
+
+        ReqTraceReader reader(in);
+        ReqTraceRecord r;
+        while (reader.next(r)) {
+            out << std::dec << std::setw(16) << r.tick << " "
+                << std::setw(3) << r.socket << " "
+                << std::setw(5) << r.requestor << " "
+                << commandNames[r.command]
+                << " 0x" << std::hex << std::setw(16) << std::setfill('0')
+                << r.addr << std::setfill(' ') << std::dec
+                << " " << r.size << "\n";
+        }
+        return reader.valid();
+    }
+
+private:
+    bool get(uint64_t& v)
+    {
+        v = 0;
+        for (unsigned shift = 0; shift < 64; shift += 7) {
+            int c = in.get();
+            if (c == std::istream::traits_type::eof()) {
+                return false;
+            }
+            v |= uint64_t(c & 0x7f) << shift;
+            if (!(c & 0x80)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::istream& in;
+    bool ok;
+    uint64_t tick = 0;
+    uint64_t addr = 0;
+};
+
+} // namespace Gem5SystemC
+
+#endif
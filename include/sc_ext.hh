@@ -62,9 +62,31 @@ class Gem5Extension: public tlm::tlm_extension<Gem5Extension>
     void setCoreID(unsigned int id) {this->coreId= id;}
     unsigned int getCoreID() {return this->coreId;}
 
+    /**
+     * Posted write: gem5 is answered at END_REQ, the data is held in a
+     * posted-write slot of the SCSlavePort until the target completes.
+     * The packet is cleared once gem5 has its response.
+     */
+    void setPacket(gem5::PacketPtr packet) {this->Packet = packet;}
+    void setPostedSlot(int slot) {this->postedSlot = slot;}
+    int getPostedSlot() {return this->postedSlot;}
+    bool isPosted() {return this->postedSlot >= 0;}
+
+    /**
+     * When the port received the request, saw END_REQ and BEGIN_RESP,
+     * for the latency statistics. MaxTick if not (yet) seen.
+     */
+    struct Timestamps
+    {
+        gem5::Tick request = gem5::MaxTick;
+        gem5::Tick endReq = gem5::MaxTick;
+        gem5::Tick beginResp = gem5::MaxTick;
+    } timestamps;
+
   private:
     gem5::PacketPtr Packet;
     unsigned int coreId; // equals to target port in sc_slave_port
+    int postedSlot = -1;
 };
 
 }
@@ -38,6 +38,7 @@
 #include <systemc>
 #include <tlm>
 
+#include "chrome_trace.h"
 #include "mem/external_master.hh"
 #include "sc_peq.hh"
 #include "sim_control.hh"
@@ -77,8 +78,11 @@ class SCMasterPort : public gem5::ExternalMaster::ExternalPort
     struct TlmSenderState : public gem5::Packet::SenderState
     {
         tlm::tlm_generic_payload& trans;
+        // for the ChromeTrace
+        gem5::Tick beginReq;
+        gem5::Tick endReq = gem5::MaxTick;
         TlmSenderState(tlm::tlm_generic_payload& trans)
-          : trans(trans)
+          : trans(trans), beginReq(gem5::curTick())
         {
         }
     };
@@ -92,6 +96,17 @@ class SCMasterPort : public gem5::ExternalMaster::ExternalPort
     bool needToSendRetry;
 
     bool responseInProgress;
+    gem5::Tick responseStart;
+
+    /**
+     * Process of the port in the ChromeTrace, assigned on first use, with
+     * the request track 0 and the response track 1
+     */
+    uint32_t tracePid;
+    uint32_t getTracePid(ChromeTrace& trace);
+    void traceResponse(tlm::tlm_generic_payload& trans);
+
+    uint64_t transactions;
 
     Gem5MasterTransactor* transactor;
 
@@ -125,6 +140,9 @@ class SCMasterPort : public gem5::ExternalMaster::ExternalPort
 
     void bindToTransactor(Gem5MasterTransactor* transactor);
 
+    /** Timing and blocking requests received from SystemC */
+    uint64_t getTransactions() const { return transactions; }
+
     friend PayloadEvent<SCMasterPort>;
 
   private:
@@ -34,10 +34,22 @@
 #ifndef __SC_SLAVE_PORT_HH__
 #define __SC_SLAVE_PORT_HH__
 
+#include <deque>
+#include <memory>
+#include <set>
 #include <systemc>
 #include <tlm>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
+#include "amo_ext.h"
+#include "chrome_trace.h"
+#include "base/statistics.hh"
+#include "base/stats/group.hh"
 #include "mem/external_slave.hh"
+#include "req_trace.h"
+#include "sc_ext.hh"
 #include "sc_mm.hh"
 #include "sc_peq.hh"
 #include "sim_control.hh"
@@ -58,6 +70,23 @@ class BlockingPacketHelper;
     assert(gem5::curTick() == sc_core::sc_time_stamp().value()); \
 } while (0)
 
+/**
+ * Latencies of the timing transactions of one socket (i.e. core) of an
+ * SCSlavePort, in ticks:
+ *  - accept: request received until END_REQ
+ *  - service: END_REQ until BEGIN_RESP
+ *  - response retry: BEGIN_RESP until gem5 took the response
+ */
+struct SCSlavePortSocketStats : public gem5::statistics::Group
+{
+    SCSlavePortSocketStats(gem5::statistics::Group *parent,
+                           const std::string &name);
+
+    gem5::statistics::Histogram acceptLatency;
+    gem5::statistics::Histogram serviceLatency;
+    gem5::statistics::Histogram respRetryDelay;
+};
+
 /**
  * This is a gem5 slave port that translates gem5 packets to TLM transactions.
  *
@@ -108,7 +137,141 @@ class SCSlavePort : public gem5::ExternalSlave::ExternalPort
     Gem5SlaveTransactor_Multi* transactor_multi;
     BlockingPacketHelper* blk_pkt_helper;
 
+    /**
+     * recvAtomic and recvFunctional are synchronous, they use this payload
+     * with member extensions instead of allocating them. An access that
+     * re-enters the port while it is in use gets a payload from mm.
+     */
+    tlm::tlm_generic_payload syncPayload;
+    Gem5Extension syncExtension;
+    AmoExtension syncAmo;
+    bool syncPayloadBusy = false;
+
+    tlm::tlm_generic_payload* getSyncPayload(gem5::PacketPtr packet,
+                                             uint32_t socket_id);
+    void putSyncPayload(tlm::tlm_generic_payload* trans);
+
     uint32_t getSocketId(gem5::RequestorID id);
+    /**
+     * Socket of a packet. If the transactor interleaves, by address for
+     * the requestors of the cores, the others keep their socket.
+     */
+    uint32_t getSocketId(gem5::PacketPtr packet);
+    /** Find the socket of a core's requestor, false for other requestors */
+    bool findCoreSocket(gem5::RequestorID id, uint32_t& socket_id);
+
+    /**
+     * Snoop the SystemC agents that may hold lines of the packet (see
+     * snoop_filter.h). Returns the delay of the snoops.
+     */
+    sc_core::sc_time snoopAgents(gem5::PacketPtr packet, bool functional);
+
+    /** Issue BEGIN_REQ and handle the immediate answer of the target */
+    void sendBeginReq(tlm::tlm_generic_payload* trans, uint32_t socket_id,
+                      sc_core::sc_time delay);
+    void sendEndResp(tlm::tlm_generic_payload& trans, uint32_t socket_id);
+
+    /**
+     * Posted writes (see Gem5SlaveTransactor_Multi::setPostedWrites). A
+     * slot holds the data of a write gem5 already got its response for.
+     */
+    struct PostedWrite
+    {
+        std::vector<uint8_t> data;
+        std::vector<uint8_t> byteEnable;    // empty if all bytes enabled
+        gem5::Addr addr = 0;
+        bool busy = false;
+    };
+    std::vector<PostedWrite> postedWrites;
+    uint32_t postedInFlight = 0;
+    /** A request was refused for a full buffer or a hazard, send a retry */
+    bool postedRetryPending = false;
+    /** Early responses waiting for recvRespRetry */
+    std::deque<gem5::PacketPtr> postedResponses;
+
+    bool canPost(gem5::PacketPtr packet);
+    /** Does [start, end) overlap a posted write still in flight? */
+    bool postedHazard(gem5::Addr start, gem5::Addr end);
+    int allocPostedWrite(gem5::Addr addr, const uint8_t* data, unsigned size,
+                         const uint8_t* byte_enable = nullptr);
+    void respondPosted(tlm::tlm_generic_payload& trans);
+    /** Answer a packet whose write gem5 must not wait for */
+    void respondEarly(gem5::PacketPtr packet);
+    void freePostedWrite(tlm::tlm_generic_payload& trans);
+    void sendPostedResponse(gem5::PacketPtr packet);
+    /** Make functional accesses see and update posted data */
+    void functionalPostedWrites(gem5::PacketPtr packet);
+
+    /**
+     * Write combining (see Gem5SlaveTransactor_Multi::setWriteCombining),
+     * one line buffer per socket
+     */
+    struct CombineBuffer
+    {
+        gem5::Addr line = 0;
+        bool valid = false;
+        std::vector<uint8_t> data;
+        std::vector<uint8_t> byteEnable;
+        std::unique_ptr<gem5::EventFunctionWrapper> timeout;
+    };
+    std::vector<CombineBuffer> combineBuffers;
+    unsigned combineLineBytes = 0;
+    gem5::Tick combineWindow = 0;
+    /** Merged packets, answered from combineRespondEvent */
+    std::vector<gem5::PacketPtr> combinedPackets;
+    gem5::EventFunctionWrapper combineRespondEvent;
+
+    enum CombineResult { COMBINE_MERGED, COMBINE_RETRY, COMBINE_PASS };
+    CombineResult combineWrite(gem5::PacketPtr packet, uint32_t socket_id);
+    /**
+     * Issue the line buffered for a socket as a posted write. Fails if the
+     * socket is blocked or the write has to wait for a posted-write slot,
+     * with retry a request retry is sent to gem5 once that has cleared.
+     */
+    bool flushCombine(uint32_t socket_id, bool retry);
+    void combineTimeout(uint32_t socket_id);
+    void respondCombined();
+    void scheduleEvent(gem5::Event& event, gem5::Tick when);
+
+    /**
+     * Instruction fetch bypass (see FetchBypassConfig): fetches of these
+     * requestors are read from the DMI region cached for their socket in
+     * fetchDmi or by debug transport, and answered after fetchLatency from
+     * fetchResponses
+     */
+    std::set<gem5::RequestorID> instRequestors;
+    std::unordered_set<gem5::RequestorID> fetchBypassRequestors;
+    gem5::Tick fetchLatency = 0;
+    std::vector<tlm::tlm_dmi> fetchDmi;
+    std::vector<bool> fetchDmiValid;
+    std::deque<std::pair<gem5::Tick, gem5::PacketPtr>> fetchResponses;
+    gem5::EventFunctionWrapper fetchRespondEvent;
+
+    void initFetchBypass();
+    bool fetchBypass(gem5::PacketPtr packet);
+    void respondFetches();
+    void invalidate_direct_mem_ptr(int socket_id, sc_dt::uint64 start,
+                                   sc_dt::uint64 end);
+
+    /** Per socket latency histograms, set up on binding a multi transactor */
+    std::vector<std::unique_ptr<SCSlavePortSocketStats>> socketStats;
+    void initStats(uint32_t sockets);
+    SCSlavePortSocketStats* getSocketStats(tlm::tlm_generic_payload& trans);
+    void sampleEndReq(tlm::tlm_generic_payload& trans);
+    void sampleBeginResp(tlm::tlm_generic_payload& trans);
+    void sampleRespSent(tlm::tlm_generic_payload& trans);
+
+    /**
+     * Process of the port in the ChromeTrace, assigned on first use. Socket
+     * i has the request track 2 * i and the response track 2 * i + 1.
+     */
+    uint32_t tracePid = 0;
+    uint32_t getTracePid(ChromeTrace& trace);
+
+    uint64_t transactions = 0;
+    /** Capture of the accepted requests, see setRequestCapture */
+    std::unique_ptr<ReqTraceWriter> capture;
+    void acceptRequest(gem5::PacketPtr packet, uint32_t socket_id);
 
      /*
      * Keep track of the request port of cores
@@ -122,6 +285,12 @@ class SCSlavePort : public gem5::ExternalSlave::ExternalPort
     tlm::tlm_sync_enum nb_transport_bw(tlm::tlm_generic_payload& trans,
                                        tlm::tlm_phase& phase,
                                        sc_core::sc_time& t);
+    /** The same, from a socket of a multi transactor */
+    tlm::tlm_sync_enum nb_transport_bw_tagged(int socket_id,
+                                              tlm::tlm_generic_payload& trans,
+                                              tlm::tlm_phase& phase,
+                                              sc_core::sc_time& t)
+        { return nb_transport_bw(trans, phase, t); }
 
     SCSlavePort(const std::string &name_,
                 const std::string &systemc_name,
@@ -132,6 +301,12 @@ class SCSlavePort : public gem5::ExternalSlave::ExternalPort
 
     void updateCorePortMap(std::map<const std::string,
       std::list<gem5::RequestorID>> map);
+    void setInstRequestors(const std::set<gem5::RequestorID>& ids)
+        { instRequestors = ids; }
+    /** Timing and atomic requests accepted from gem5 */
+    uint64_t getTransactions() const { return transactions; }
+    /** Finish the request capture, if any */
+    void closeCapture();
     // initiate socket map depends on config file // TODO
     void initSocketMap();
 
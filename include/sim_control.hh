@@ -45,6 +45,7 @@
 #include "sim/system.hh"
 #include "sim_control_if.hh"
 #include <memory.h>
+#include <set>
 
 namespace Gem5SystemC
 {
@@ -78,6 +79,25 @@ class Gem5SimControl : public Module, public Gem5SimControlInterface
      * Keep track of the request port of cores
      */
     std::map<const std::string, std::list<gem5::RequestorID>> cpuPorts;
+    /** The instruction fetch requestors among them */
+    std::set<gem5::RequestorID> instRequestors;
+
+    /**
+     * Progress report every progressInterval simulated ticks, by a low
+     * priority gem5 event. The rates are over the last interval.
+     */
+    gem5::Tick progressInterval = 0;
+    gem5::EventFunctionWrapper progressEvent;
+    struct
+    {
+        gem5::Tick tick;
+        double hostSeconds;
+        uint64_t transactions;
+        double insts;
+    } lastProgress;
+    void reportProgress();
+    /** Requests crossing the boundary through all the ports */
+    uint64_t countTransactions() const;
 
     /// Pointer to a previously created instance.
     //static Gem5SimControl* instance;
@@ -141,6 +161,13 @@ class Gem5SimControl : public Module, public Gem5SimControlInterface
     void initCoreInfo(gem5::CxxConfigManager* cxx_manager);
     unsigned int getCoreIDByRequestorID(gem5::RequestorID id);
 
+    /**
+     * Print the simulated time, host time and simulation speed every
+     * interval simulated ticks while run() simulates, 0 disables it
+     */
+    void setProgressInterval(gem5::Tick interval)
+        { progressInterval = interval; }
+
     void run();
 };
 
@@ -1,55 +1,205 @@
 #ifndef SIMPLE_BUS_H
 #define SIMPLE_BUS_H
+#include <tlm_utils/peq_with_cb_and_phase.h>
 #include <tlm_utils/simple_initiator_socket.h>
 #include <tlm_utils/simple_target_socket.h>
 
-#include <map>
+#include <deque>
 #include <stdexcept>
 #include <systemc>
+#include <unordered_map>
+#include <vector>
+
+#include "address_map.h"
+#include "dmi_util.h"
+#include "host_time.h"
 
 namespace Gem5SystemC{
-struct PortMapping
+
+/**
+ * Default decoder of the bus. Targets are mapped at elaboration time, the
+ * decode is a binary search over a sorted flat map with a last-hit cache.
+ */
+class RuntimeDecoder
 {
-    uint64_t start;
-    uint64_t end;
+  public:
+    bool map(uint64_t start, uint64_t end, unsigned target) {
+        return address_map.insert(start, end, target);
+    }
 
-    PortMapping(uint64_t start, uint64_t end) : start(start), end(end) {
-        assert(end >= start);
+    int decode(uint64_t addr) const {
+        auto entry = address_map.find(addr);
+        return entry ? int(entry->value) : -1;
     }
 
-    bool contains(uint64_t addr) {
-        return addr >= start && addr <= end;
+    /** Like decode(), also returns the bounds of the matching range */
+    int lookup(uint64_t addr, uint64_t &start, uint64_t &end) const {
+        auto entry = address_map.find(addr);
+        if (!entry) {
+            return -1;
+        }
+        start = entry->start;
+        end = entry->end;
+        return entry->value;
     }
 
-    uint64_t global_to_local(uint64_t addr) {
-        return addr - start;
+    unsigned num_targets() const {
+        unsigned n = 0;
+        for (auto &entry : address_map.entries()) {
+            n = std::max(n, entry.value + 1);
+        }
+        return n;
     }
+
+  private:
+    AddressMap<unsigned> address_map;
+};
+
+/**
+ * Decoder for a map fixed at compile time, see StaticAddressMap. E.g.
+ *
+ *     struct PlatformMap {
+ *         static constexpr AddressRange ranges[] = {
+ *             { 0x00000000, 0x7fffffff, 0 },   // memory
+ *             { 0x80000000, 0x80000fff, 1 },   // uart
+ *         };
+ *     };
+ *     using PlatformBus = BasicSimpleBus<StaticDecoder<PlatformMap>>;
+ */
+template <typename Map>
+struct StaticDecoder
+{
+    int decode(uint64_t addr) const {
+        return StaticAddressMap<Map>::decode(addr);
+    }
+
+    int lookup(uint64_t addr, uint64_t &start, uint64_t &end) const {
+        auto range = StaticAddressMap<Map>::find(addr);
+        if (!range) {
+            return -1;
+        }
+        start = range->start;
+        end = range->end;
+        return range->target;
+    }
+
+    unsigned num_targets() const {
+        return StaticAddressMap<Map>::maxTarget() + 1;
+    }
+};
+
+enum SimpleBusArbitration
+{
+    ARB_FIXED_PRIORITY, // the lowest initiator socket index wins
+    ARB_ROUND_ROBIN     // the winner becomes the lowest priority
+};
+
+/** Timing of the AT mode of the bus, the LT mode is untimed */
+struct SimpleBusConfig
+{
+    SimpleBusArbitration arbitration = ARB_ROUND_ROBIN;
+    // From the end of the arbitration round to BEGIN_REQ at the target
+    sc_core::sc_time arbitration_delay = sc_core::SC_ZERO_TIME;
+    // Bytes per second of each target port, 0 is unlimited. Can be set per
+    // port with set_target_bandwidth().
+    double target_bandwidth = 0;
 };
 
-template <unsigned int NR_OF_INITIATORS, unsigned int NR_OF_TARGETS>
-struct SimpleBus : sc_core::sc_module
+/**
+ * A simple bus. The number of initiator and target sockets is set at
+ * construction, the address decode is done by the Decoder policy.
+ *
+ * b_transport is forwarded directly (LT mode). nb_transport (AT mode) is
+ * arbitrated: every target has one waiting slot per initiator, and a
+ * request is granted once the target has accepted the previous one, i.e.
+ * END_REQ is only returned to the initiator when the target accepts. A
+ * target port carries one transfer at a time at its configured bandwidth.
+ * Responses are queued per initiator, and END_RESP is returned to the
+ * target once the initiator has taken the response.
+ *
+ * DMI requests are forwarded to the decoded target and the granted region
+ * is clipped to the range mapped to that target. Invalidations from any
+ * target are broadcast to all initiators.
+ */
+template <typename Decoder = RuntimeDecoder>
+struct BasicSimpleBus : sc_core::sc_module
 {
-    std::array<tlm_utils::simple_target_socket<SimpleBus>, NR_OF_INITIATORS> tsocks;
+    sc_core::sc_vector<tlm_utils::simple_target_socket_tagged<BasicSimpleBus>>
+        tsocks;
 
-    std::array<tlm_utils::simple_initiator_socket<SimpleBus>, NR_OF_TARGETS> isocks;
-    std::array<PortMapping *, NR_OF_TARGETS> ports;
+    sc_core::sc_vector<
+        tlm_utils::simple_initiator_socket_tagged<BasicSimpleBus>> isocks;
 
-    SimpleBus(sc_core::sc_module_name) {
-        for (auto &s : tsocks) {
-            s.register_b_transport(this, &SimpleBus::transport);
-            s.register_transport_dbg(this, &SimpleBus::transport_dbg);
+    SC_HAS_PROCESS(BasicSimpleBus);
+    BasicSimpleBus(sc_core::sc_module_name, unsigned nr_of_initiators,
+                   unsigned nr_of_targets,
+                   const SimpleBusConfig& config_ = SimpleBusConfig())
+        : tsocks("tsock", nr_of_initiators),
+          isocks("isock", nr_of_targets),
+          fw_peq(this, &BasicSimpleBus::fw_peq_cb),
+          bw_peq(this, &BasicSimpleBus::bw_peq_cb),
+          config(config_),
+          waiting(nr_of_targets,
+                  std::vector<tlm::tlm_generic_payload*>(nr_of_initiators)),
+          target_request(nr_of_targets),
+          next_initiator(nr_of_targets),
+          port_free(nr_of_targets),
+          port_bandwidth(nr_of_targets, config_.target_bandwidth),
+          response_queues(nr_of_initiators),
+          initiator_response(nr_of_initiators)
+    {
+        for (unsigned i = 0; i < tsocks.size(); i++) {
+            tsocks[i].register_b_transport(this, &BasicSimpleBus::transport,
+                                           i);
+            tsocks[i].register_transport_dbg(
+                this, &BasicSimpleBus::transport_dbg, i);
+            tsocks[i].register_nb_transport_fw(
+                this, &BasicSimpleBus::nb_transport_fw, i);
+            tsocks[i].register_get_direct_mem_ptr(
+                this, &BasicSimpleBus::get_direct_mem_ptr, i);
         }
+        for (unsigned i = 0; i < isocks.size(); i++) {
+            isocks[i].register_nb_transport_bw(
+                this, &BasicSimpleBus::nb_transport_bw, i);
+            isocks[i].register_invalidate_direct_mem_ptr(
+                this, &BasicSimpleBus::invalidate_direct_mem_ptr, i);
+        }
+        if (decoder.num_targets() > isocks.size()) {
+            SC_REPORT_FATAL(name(), "Address map refers to unknown target");
+        }
+
+        SC_METHOD(arbitrate);
+        sensitive << arbitrate_event;
+        dont_initialize();
     }
 
-    int decode(uint64_t addr) {
-        for (unsigned i = 0; i < NR_OF_TARGETS; ++i) {
-            if (ports[i]->contains(addr))
-                return i;
+    /** Bytes per second of target port id in AT mode, 0 is unlimited */
+    void set_target_bandwidth(unsigned id, double bandwidth) {
+        if (id >= isocks.size()) {
+            SC_REPORT_FATAL(name(), "Bandwidth of unknown target socket");
         }
-        return -1;
+        port_bandwidth[id] = bandwidth;
     }
 
-    void transport(tlm::tlm_generic_payload &trans, sc_core::sc_time &delay) {
+    /**
+     * Map the inclusive address range [start, end] to target socket id.
+     * Only available with the RuntimeDecoder.
+     */
+    void map_target(unsigned id, uint64_t start, uint64_t end) {
+        if (id >= isocks.size()) {
+            SC_REPORT_FATAL(name(), "Mapping to unknown target socket");
+        }
+        if (!decoder.map(start, end, id)) {
+            SC_REPORT_FATAL(name(), "Invalid or overlapping address range");
+        }
+    }
+
+    int decode(uint64_t addr) {
+        return decoder.decode(addr);
+    }
+
+    void transport(int, tlm::tlm_generic_payload &trans,
+                   sc_core::sc_time &delay) {
         auto addr = trans.get_address();
         auto id = decode(addr);
 
@@ -58,11 +208,11 @@ struct SimpleBus : sc_core::sc_module
             return;
         }
         // No need to change the address
-        // trans.set_address(ports[id]->global_to_local(addr));
         isocks[id]->b_transport(trans, delay);
     }
 
-    unsigned transport_dbg(tlm::tlm_generic_payload &trans) {
+    unsigned transport_dbg(int, tlm::tlm_generic_payload &trans) {
+        HostTimeScope host_time(HOST_TIME_INTERCONNECT);
         // receive Functional request from gem5 world
         // forward to memory directly
         auto addr = trans.get_address();
@@ -74,7 +224,229 @@ struct SimpleBus : sc_core::sc_module
         }
         return isocks[id]->transport_dbg(trans);
     }
+
+    bool get_direct_mem_ptr(int, tlm::tlm_generic_payload &trans,
+                            tlm::tlm_dmi &dmi) {
+        uint64_t start, end;
+        auto id = decoder.lookup(trans.get_address(), start, end);
+        if (id < 0) {
+            return false;
+        }
+        bool granted = isocks[id]->get_direct_mem_ptr(trans, dmi);
+        clip_dmi(dmi, start, end);
+        return granted;
+    }
+
+    void invalidate_direct_mem_ptr(int, sc_dt::uint64 start,
+                                   sc_dt::uint64 end) {
+        for (unsigned i = 0; i < tsocks.size(); i++) {
+            tsocks[i]->invalidate_direct_mem_ptr(start, end);
+        }
+    }
+
+    tlm::tlm_sync_enum nb_transport_fw(int id,
+                                       tlm::tlm_generic_payload &trans,
+                                       tlm::tlm_phase &phase,
+                                       sc_core::sc_time &delay) {
+        HostTimeScope host_time(HOST_TIME_INTERCONNECT);
+        if (phase == tlm::BEGIN_REQ) {
+            auto target = decode(trans.get_address());
+            if (target < 0) {
+                trans.set_response_status(tlm::TLM_ADDRESS_ERROR_RESPONSE);
+                return tlm::TLM_COMPLETED;
+            }
+            routes[&trans] = Route{unsigned(id), unsigned(target), true};
+        }
+        fw_peq.notify(trans, phase, delay);
+        return tlm::TLM_ACCEPTED;
+    }
+
+    tlm::tlm_sync_enum nb_transport_bw(int, tlm::tlm_generic_payload &trans,
+                                       tlm::tlm_phase &phase,
+                                       sc_core::sc_time &delay) {
+        HostTimeScope host_time(HOST_TIME_INTERCONNECT);
+        bw_peq.notify(trans, phase, delay);
+        return tlm::TLM_ACCEPTED;
+    }
+
+  private:
+    /** Path of a transaction in AT mode */
+    struct Route
+    {
+        unsigned initiator;
+        unsigned target;
+        bool target_end_resp;   // the target expects END_RESP
+    };
+
+    // Phases from the initiators
+    void fw_peq_cb(tlm::tlm_generic_payload &trans,
+                   const tlm::tlm_phase &phase) {
+        HostTimeScope host_time(HOST_TIME_INTERCONNECT);
+        if (phase == tlm::BEGIN_REQ) {
+            auto &route = routes.at(&trans);
+            waiting[route.target][route.initiator] = &trans;
+            arbitrate_event.notify(sc_core::SC_ZERO_TIME);
+        } else if (phase == tlm::END_RESP) {
+            end_response(trans);
+        } else {
+            SC_REPORT_FATAL(name(), "Illegal phase received from initiator");
+        }
+    }
+
+    // Phases from the targets
+    void bw_peq_cb(tlm::tlm_generic_payload &trans,
+                   const tlm::tlm_phase &phase) {
+        HostTimeScope host_time(HOST_TIME_INTERCONNECT);
+        auto &route = routes.at(&trans);
+        if (phase == tlm::END_REQ) {
+            end_request(trans);
+        } else if (phase == tlm::BEGIN_RESP) {
+            // BEGIN_RESP implies END_REQ
+            if (target_request[route.target] == &trans) {
+                end_request(trans);
+            }
+            response_queues[route.initiator].push_back(&trans);
+            if (!initiator_response[route.initiator]) {
+                send_response(route.initiator);
+            }
+        } else {
+            SC_REPORT_FATAL(name(), "Illegal phase received from target");
+        }
+    }
+
+    /**
+     * Grant every idle target to one of its waiting initiators. Runs one
+     * delta after a request arrives or a target becomes idle, so requests
+     * arriving at the same time compete.
+     */
+    void arbitrate() {
+        HostTimeScope host_time(HOST_TIME_INTERCONNECT);
+        for (unsigned t = 0; t < isocks.size(); t++) {
+            if (target_request[t]) {
+                continue;
+            }
+            int winner = pick(t);
+            if (winner < 0) {
+                continue;
+            }
+            auto trans = waiting[t][winner];
+            waiting[t][winner] = nullptr;
+            target_request[t] = trans;
+            if (config.arbitration == ARB_ROUND_ROBIN) {
+                next_initiator[t] = (winner + 1) % tsocks.size();
+            }
+
+            tlm::tlm_phase phase = tlm::BEGIN_REQ;
+            sc_core::sc_time delay = port_delay(t, *trans);
+            auto status = isocks[t]->nb_transport_fw(*trans, phase, delay);
+            if (status == tlm::TLM_UPDATED) {
+                bw_peq.notify(*trans, phase, delay);
+            } else if (status == tlm::TLM_COMPLETED) {
+                routes.at(trans).target_end_resp = false;
+                phase = tlm::BEGIN_RESP;
+                bw_peq.notify(*trans, phase, delay);
+            }
+        }
+    }
+
+    int pick(unsigned target) {
+        unsigned n = tsocks.size();
+        unsigned first = config.arbitration == ARB_ROUND_ROBIN
+            ? next_initiator[target] : 0;
+        for (unsigned k = 0; k < n; k++) {
+            unsigned i = (first + k) % n;
+            if (waiting[target][i]) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    /**
+     * Delay until the request can start on the target port, and reserve
+     * the port for the transfer of its data.
+     */
+    sc_core::sc_time port_delay(unsigned target,
+                                const tlm::tlm_generic_payload &trans) {
+        auto now = sc_core::sc_time_stamp();
+        auto start = now + config.arbitration_delay;
+        if (port_bandwidth[target] <= 0) {
+            return start - now;
+        }
+        if (port_free[target] > start) {
+            start = port_free[target];
+        }
+        port_free[target] = start + sc_core::sc_time(
+            trans.get_data_length() / port_bandwidth[target], sc_core::SC_SEC);
+        return start - now;
+    }
+
+    // The target accepted the request: release the initiator and the target
+    void end_request(tlm::tlm_generic_payload &trans) {
+        auto &route = routes.at(&trans);
+        target_request[route.target] = nullptr;
+
+        tlm::tlm_phase phase = tlm::END_REQ;
+        sc_core::sc_time delay = sc_core::SC_ZERO_TIME;
+        tsocks[route.initiator]->nb_transport_bw(trans, phase, delay);
+        arbitrate_event.notify(sc_core::SC_ZERO_TIME);
+    }
+
+    void send_response(unsigned initiator) {
+        auto trans = response_queues[initiator].front();
+        response_queues[initiator].pop_front();
+        initiator_response[initiator] = trans;
+
+        tlm::tlm_phase phase = tlm::BEGIN_RESP;
+        sc_core::sc_time delay = sc_core::SC_ZERO_TIME;
+        auto status = tsocks[initiator]->nb_transport_bw(*trans, phase, delay);
+        if (status == tlm::TLM_COMPLETED ||
+            (status == tlm::TLM_UPDATED && phase == tlm::END_RESP)) {
+            phase = tlm::END_RESP;
+            fw_peq.notify(*trans, phase, delay);
+        }
+    }
+
+    // The initiator took the response: release the target and send the
+    // next queued response
+    void end_response(tlm::tlm_generic_payload &trans) {
+        auto route = routes.at(&trans);
+        routes.erase(&trans);
+        initiator_response[route.initiator] = nullptr;
+
+        if (route.target_end_resp) {
+            tlm::tlm_phase phase = tlm::END_RESP;
+            sc_core::sc_time delay = sc_core::SC_ZERO_TIME;
+            isocks[route.target]->nb_transport_fw(trans, phase, delay);
+        }
+        if (!response_queues[route.initiator].empty()) {
+            send_response(route.initiator);
+        }
+    }
+
+    Decoder decoder;
+
+    tlm_utils::peq_with_cb_and_phase<BasicSimpleBus> fw_peq;
+    tlm_utils::peq_with_cb_and_phase<BasicSimpleBus> bw_peq;
+    sc_core::sc_event arbitrate_event;
+
+    SimpleBusConfig config;
+    std::unordered_map<tlm::tlm_generic_payload*, Route> routes;
+
+    // Per target: request waiting from each initiator, request awaiting
+    // END_REQ, round robin position and port reservation
+    std::vector<std::vector<tlm::tlm_generic_payload*>> waiting;
+    std::vector<tlm::tlm_generic_payload*> target_request;
+    std::vector<unsigned> next_initiator;
+    std::vector<sc_core::sc_time> port_free;
+    std::vector<double> port_bandwidth;
+
+    // Per initiator: queued responses and the response awaiting END_RESP
+    std::vector<std::deque<tlm::tlm_generic_payload*>> response_queues;
+    std::vector<tlm::tlm_generic_payload*> initiator_response;
 };
+
+using SimpleBus = BasicSimpleBus<>;
 }
 
 #endif
@@ -36,16 +36,53 @@
 #include <tlm_utils/simple_initiator_socket.h>
 
 #include <map>
+#include <string>
 #include <systemc>
 #include <tlm>
+#include <vector>
 
 #include "sc_slave_port.hh"
 #include "sim_control_if.hh"
+#include "snoop_filter.h"
 
 namespace Gem5SystemC
 {
 
-typedef tlm_utils::simple_initiator_socket<SCSlavePort> init_port_type;
+/** Tagged with the socket index, so SCSlavePort knows which one calls back */
+typedef tlm_utils::simple_initiator_socket_tagged<SCSlavePort>
+    init_port_type;
+
+/**
+ * Address interleaving of Gem5SlaveTransactor_Multi. A request of a core
+ * goes to socket firstSocket + f(addr >> granularityBits) % n, n being the
+ * number of sockets from firstSocket on. f is the identity, or with
+ * xorHash the XOR of all log2(n) wide bit groups of the index, which
+ * spreads strided accesses over the sockets. Requests of other requestors
+ * (system port, writebacks, functional accesses) are not interleaved and
+ * keep socket 0.
+ */
+struct InterleaveConfig
+{
+    // 6 interleaves cache lines, 12 pages
+    unsigned granularityBits = 6;
+    bool xorHash = false;
+    // sockets below are not interleaved over, e.g. the system port socket
+    uint32_t firstSocket = 0;
+};
+
+/**
+ * Instruction fetch bypass of Gem5SlaveTransactor_Multi. Timing fetches of
+ * the selected cores are served by the port itself, from a DMI region of
+ * the memory or else by debug transport, and answered after latency. Data
+ * accesses stay fully timed.
+ */
+struct FetchBypassConfig
+{
+    bool enabled = false;
+    sc_core::sc_time latency = sc_core::sc_time(1, sc_core::SC_NS);
+    // gem5 names of the cores whose fetches bypass, empty for all cores
+    std::vector<std::string> cores;
+};
 
 class Gem5SlaveTransactor : public sc_core::sc_module
 {
@@ -82,6 +119,13 @@ class Gem5SlaveTransactor_Multi : public sc_core::sc_module
     sc_core::sc_vector<init_port_type> sockets;
     // basic method
     sc_core::sc_port<Gem5SimControlInterface> sim_control;
+    /**
+     * Snoop sockets, one per SystemC agent with a cache (see
+     * setSnoopAgents). Agents record the lines they hold in snoopFilter,
+     * indexed by their socket.
+     */
+    sc_core::sc_vector<init_port_type> snoop_sockets;
+    SnoopFilter snoopFilter;
 
     // TODO: Rename
     std::map<uint32_t, std::vector<int>> socket_core_map;
@@ -92,6 +136,17 @@ class Gem5SlaveTransactor_Multi : public sc_core::sc_module
     uint32_t count = 0 ; // used for generate socket name
     std::string getNameForNewSocket(std::string name);
 
+    bool interleaving = false;
+    InterleaveConfig interleaveConfig;
+    uint32_t interleaveWays = 0;
+    unsigned interleaveHashBits = 0;
+
+    uint32_t postedWrites = 0;
+    unsigned combineLineBytes = 0;
+    sc_core::sc_time combineWindow;
+    FetchBypassConfig fetchBypass;
+    std::string requestCapture;
+
   protected:
     static Gem5SlaveTransactor_Multi* instance;
 
@@ -117,6 +172,56 @@ class Gem5SlaveTransactor_Multi : public sc_core::sc_module
     std::map<uint32_t, std::vector<int>> getSocketCoreMap()
         { return this->socket_core_map;}
 
+    /**
+     * Select the socket of a core's request by its address instead of by
+     * the requesting core (socket_core_map). With a gem5 cache, socket 0
+     * belongs to the system port and firstSocket must be at least 1.
+     */
+    void setInterleaving(const InterleaveConfig& config);
+    bool isInterleaving() { return interleaving; }
+    uint32_t getInterleavedSocket(uint64_t addr) const;
+
+    /**
+     * Posted-write mode: plain timing writes are answered to gem5 at
+     * END_REQ and finished in SystemC from a copy of their data. At most
+     * slots writes are outstanding, 0 (default) disables the mode. Must be
+     * set before the port binds, i.e. before the end of elaboration.
+     */
+    void setPostedWrites(uint32_t slots) { postedWrites = slots; }
+    uint32_t getPostedWrites() { return postedWrites; }
+
+    /**
+     * Write combining, on top of posted writes: per socket, writes within
+     * one lineBytes aligned line are merged and issued as one transaction,
+     * with byte enables if the line is not written contiguously. A line is
+     * issued when it is full, window after its first write, or before an
+     * access that must not overtake it (overlapping reads and writes,
+     * uncacheable, acquire/release and flush requests).
+     */
+    void setWriteCombining(unsigned lineBytes, const sc_core::sc_time& window);
+
+    /**
+     * Create the snoop sockets for agents caching lines of lineBytes. Must
+     * be called once, during elaboration.
+     */
+    void setSnoopAgents(uint32_t agents, unsigned lineBytes = 64);
+    bool isSnooping() { return snoop_sockets.size() > 0; }
+
+    /** Must be set before the port binds, like setPostedWrites */
+    void setFetchBypass(const FetchBypassConfig& config)
+        { fetchBypass = config; }
+    const FetchBypassConfig& getFetchBypass() { return fetchBypass; }
+    /**
+     * Record every request the port accepts from gem5 in a binary trace at
+     * path (see req_trace.h). Must be set before the port binds, like
+     * setPostedWrites
+     */
+    void setRequestCapture(const std::string& path)
+        { requestCapture = path; }
+    const std::string& getRequestCapture() { return requestCapture; }
+    unsigned getCombineLineBytes() { return combineLineBytes; }
+    sc_core::sc_time getCombineWindow() { return combineWindow; }
+
     static Gem5SlaveTransactor_Multi* getInstance(sc_core::sc_module_name name,
                         const std::string& portName,
                         uint32_t socket_num);
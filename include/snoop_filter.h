@@ -0,0 +1,123 @@
+/**
+ * @file snoop_filter.h
+ * @brief Directory of the lines cached by SystemC agents, for snooping
+ *
+ * SystemC agents with caches (e.g. accelerators) behind an SCSlavePort keep
+ * lines of memory that gem5 accesses through the port must see. Each agent
+ * records in the SnoopFilter which lines it holds, and the port snoops an
+ * agent only for lines the filter says it may hold. An access to lines no
+ * agent holds costs one hash lookup per line.
+ *
+ * A snoop is a transaction with a SnoopExtension, sent to the agent with
+ * b_transport (or transport_dbg for functional accesses). On a b_transport
+ * snoop the agent must write dirty data of the lines back to memory, and
+ * drop the lines if invalidate is set; it must not call wait(), since
+ * snoops are issued from gem5's event loop. The command is
+ * TLM_IGNORE_COMMAND and there is no data. A functional snoop carries the
+ * data of the gem5 access instead: the agent overwrites it with its dirty
+ * data for a read and updates its copy for a write, without changing any
+ * state.
+ */
+
+#ifndef SNOOP_FILTER_H
+#define SNOOP_FILTER_H
+
+#include <algorithm>
+#include <cstdint>
+#include <systemc>
+#include <tlm>
+#include <unordered_map>
+
+namespace Gem5SystemC
+{
+
+class SnoopExtension : public tlm::tlm_extension<SnoopExtension>
+{
+public:
+    /** The gem5 access writes, the agent has to give up the lines */
+    bool invalidate = false;
+
+    tlm::tlm_extension_base* clone() const override
+    {
+        return new SnoopExtension(*this);
+    }
+
+    void copy_from(const tlm::tlm_extension_base& ext) override
+    {
+        *this = static_cast<const SnoopExtension&>(ext);
+    }
+};
+
+/**
+ * The lines held by up to 32 agents, each line maps to the mask of its
+ * holders. Lines are only tracked while held.
+ */
+class SnoopFilter
+{
+public:
+    explicit SnoopFilter(unsigned line_bytes = 64)
+        : line_bits(0)
+    {
+        while ((1u << line_bits) < line_bytes) {
+            line_bits++;
+        }
+    }
+
+    /** Agent fetched the line containing addr */
+    void add(uint64_t addr, unsigned agent)
+    {
+        sc_assert(agent < 32);
+        lines[addr >> line_bits] |= uint32_t(1) << agent;
+    }
+
+    /** Agent evicted the line containing addr */
+    void remove(uint64_t addr, unsigned agent)
+    {
+        auto it = lines.find(addr >> line_bits);
+        if (it == lines.end()) {
+            return;
+        }
+        it->second &= ~(uint32_t(1) << agent);
+        if (it->second == 0) {
+            lines.erase(it);
+        }
+    }
+
+    /** Agent gives up the lines of [addr, addr + size) */
+    void remove(uint64_t addr, unsigned size, unsigned agent)
+    {
+        for (uint64_t line = addr >> line_bits;
+             line <= (addr + std::max(size, 1u) - 1) >> line_bits; line++) {
+            remove(line << line_bits, agent);
+        }
+    }
+
+    /** Mask of the agents that may hold lines of [addr, addr + size) */
+    uint32_t holders(uint64_t addr, unsigned size) const
+    {
+        if (lines.empty()) {
+            return 0;
+        }
+        uint32_t mask = 0;
+        for (uint64_t line = addr >> line_bits;
+             line <= (addr + std::max(size, 1u) - 1) >> line_bits; line++) {
+            auto it = lines.find(line);
+            if (it != lines.end()) {
+                mask |= it->second;
+            }
+        }
+        return mask;
+    }
+
+    bool empty() const { return lines.empty(); }
+    size_t size() const { return lines.size(); }
+    void clear() { lines.clear(); }
+
+private:
+    unsigned line_bits;
+    std::unordered_map<uint64_t, uint32_t> lines;
+};
+
+} // namespace Gem5SystemC
+
+#endif
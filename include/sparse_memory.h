@@ -0,0 +1,547 @@
+/**
+ * @file sparse_memory.h
+ * @brief Sparse SystemC memory target
+ *
+ * A SparseMemory covers [start, start + size) of a 64-bit address space but
+ * only allocates host memory for the pages that are written, so the
+ * footprint is proportional to the touched pages. Reads of untouched pages
+ * return zeros without allocating them. The page found last is cached, so
+ * runs of accesses to the same page skip the page table lookup.
+ *
+ * b_transport, nb_transport (answered in a single call with BEGIN_RESP),
+ * transport_dbg and DMI are supported. DMI is granted per page, since
+ * pages are not contiguous in host memory, and a page is allocated when
+ * DMI is granted for it. Pages live until a snapshot is restored, which
+ * invalidates all DMI pointers.
+ *
+ * With a backing file the memory is a MAP_PRIVATE mapping of the file:
+ * the file provides the initial contents, is paged in lazily and never
+ * written, writes are copy-on-write. The page table then only tracks which
+ * pages hold data (the data extents of the file plus the touched pages).
+ *
+ * save_snapshot() writes the pages holding data into a sparse raw image
+ * at their offsets. restore_snapshot() brings such an image (or any raw
+ * image) back: with a backing file by mapping it in place of the current
+ * contents, which is instant, otherwise by reading its data extents.
+ * load() and fill() write data straight into the pages, used to preload
+ * program images (Gem5Wrapper::preloadImage).
+ *
+ * Atomic operations (AmoExtension) are executed in place. LR/SC
+ * reservations are kept per reservation id at a configurable granule and
+ * cleared by any write to the granule. While a page holds a reservation,
+ * DMI to it is read-only, so that all writes are seen.
+ */
+
+#ifndef SPARSE_MEMORY_H
+#define SPARSE_MEMORY_H
+
+#include <tlm_utils/simple_target_socket.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <systemc>
+#include <unordered_map>
+#include <vector>
+
+#include "amo_ext.h"
+
+namespace Gem5SystemC
+{
+
+struct SparseMemoryConfig
+{
+    /** Pages are 2^page_bits bytes, also the granularity of DMI */
+    unsigned page_bits = 12;
+    sc_core::sc_time read_latency = sc_core::sc_time(10.0, sc_core::SC_NS);
+    sc_core::sc_time write_latency = sc_core::sc_time(10.0, sc_core::SC_NS);
+    bool dmi_allowed = true;
+    /** Map this file copy-on-write as initial contents, see SparseMemory */
+    std::string backing_file;
+    /** LR/SC reservations cover 2^reservation_bits bytes */
+    unsigned reservation_bits = 6;
+};
+
+class SparseMemory : public sc_core::sc_module
+{
+public:
+    tlm_utils::simple_target_socket<SparseMemory> tsock;
+
+    SparseMemory(sc_core::sc_module_name,
+                 uint64_t start_,
+                 uint64_t size_,
+                 const SparseMemoryConfig& config_ = SparseMemoryConfig())
+        : tsock("tsock"),
+          start(start_),
+          size(size_),
+          config(config_),
+          page_size(uint64_t(1) << config_.page_bits),
+          page_mask(page_size - 1)
+    {
+        if (size == 0 || start + (size - 1) < start) {
+            SC_REPORT_FATAL(name(), "Invalid memory range");
+        }
+        if (config.reservation_bits > config.page_bits) {
+            // DMI is made read-only per page for the reservations in it
+            SC_REPORT_FATAL(name(), "Reservation granule larger than a page");
+        }
+        if (!config.backing_file.empty() && !map_file(config.backing_file)) {
+            SC_REPORT_FATAL(name(), ("Can't map backing file " +
+                                     config.backing_file).c_str());
+        }
+        tsock.register_b_transport(this, &SparseMemory::b_transport);
+        tsock.register_nb_transport_fw(this, &SparseMemory::nb_transport_fw);
+        tsock.register_transport_dbg(this, &SparseMemory::transport_dbg);
+        tsock.register_get_direct_mem_ptr(this,
+                                          &SparseMemory::get_direct_mem_ptr);
+    }
+
+    uint64_t start_address() const { return start; }
+    uint64_t end_address() const { return start + (size - 1); }
+
+    ~SparseMemory()
+    {
+        if (mapping) {
+            ::munmap(mapping, mapping_size());
+        }
+    }
+
+    /** Host memory of the pages holding data, in bytes */
+    uint64_t allocated_bytes() const { return pages.size() * page_size; }
+
+    /**
+     * Write the pages holding data to path, as a raw image of the whole
+     * range with holes for the other pages. Returns false on error.
+     *
+     * The image is written next to path and renamed over it, so path may
+     * be the file the memory is mapped from: the mapping keeps the old
+     * file, whose pages not yet copied on write are still needed.
+     */
+    bool save_snapshot(const std::string& path) const
+    {
+        std::string tmp = path + ".tmp";
+        int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            return false;
+        }
+        bool ok = ::ftruncate(fd, size) == 0;
+        for (auto it = pages.begin(); ok && it != pages.end(); ++it) {
+            uint64_t offset = it->first << config.page_bits;
+            ok = write_all(fd, it->second,
+                           std::min(page_size, size - offset), offset);
+        }
+        ok = ::close(fd) == 0 && ok;
+        if (ok && ::rename(tmp.c_str(), path.c_str()) == 0) {
+            return true;
+        }
+        ::unlink(tmp.c_str());
+        return false;
+    }
+
+    /**
+     * Replace the contents by the raw image at path, e.g. written by
+     * save_snapshot(). Data beyond the end of the image reads as zero.
+     * All DMI pointers are invalidated. Returns false on error, the
+     * contents are undefined then.
+     */
+    bool restore_snapshot(const std::string& path)
+    {
+        tsock->invalidate_direct_mem_ptr(start, end_address());
+        reservations.clear();
+        return mapping ? map_file(path) : load_file(path);
+    }
+
+    /**
+     * Write len bytes at addr straight into the pages, without going
+     * through the socket, e.g. to preload a program image. Returns false
+     * if the range is not within the memory.
+     */
+    bool load(uint64_t addr, const uint8_t* data, uint64_t len)
+    {
+        if (!within(addr, len)) {
+            return false;
+        }
+        copy(addr - start, const_cast<unsigned char*>(data), len, true);
+        return true;
+    }
+
+    /**
+     * Set len bytes at addr to value, like load(), e.g. to clear the .bss
+     * of a program image. Zeroing does not allocate untouched pages.
+     * Returns false if the range is not within the memory.
+     */
+    bool fill(uint64_t addr, uint8_t value, uint64_t len)
+    {
+        if (!within(addr, len)) {
+            return false;
+        }
+        uint64_t offset = addr - start;
+        while (len) {
+            uint64_t in_page = offset & page_mask;
+            uint64_t chunk = std::min(len, page_size - in_page);
+            if (uint8_t* p = page(offset, value != 0)) {
+                std::memset(p + in_page, value, chunk);
+            }
+            offset += chunk;
+            len -= chunk;
+        }
+        return true;
+    }
+
+private:
+    void b_transport(tlm::tlm_generic_payload& trans, sc_core::sc_time& delay)
+    {
+        trans.set_response_status(access(trans));
+        if (trans.is_response_ok()) {
+            delay += trans.is_write() ? config.write_latency
+                                      : config.read_latency;
+            trans.set_dmi_allowed(config.dmi_allowed);
+        }
+    }
+
+    tlm::tlm_sync_enum nb_transport_fw(tlm::tlm_generic_payload& trans,
+                                       tlm::tlm_phase& phase,
+                                       sc_core::sc_time& delay)
+    {
+        if (phase == tlm::BEGIN_REQ) {
+            // Accept and answer at once, the latency goes into the delay
+            b_transport(trans, delay);
+            phase = tlm::BEGIN_RESP;
+            return tlm::TLM_UPDATED;
+        }
+        if (phase == tlm::END_RESP) {
+            return tlm::TLM_COMPLETED;
+        }
+        SC_REPORT_FATAL(name(), "Illegal transaction phase");
+        return tlm::TLM_COMPLETED;
+    }
+
+    unsigned transport_dbg(tlm::tlm_generic_payload& trans)
+    {
+        trans.set_response_status(access(trans));
+        return trans.is_response_ok() ? trans.get_data_length() : 0;
+    }
+
+    bool get_direct_mem_ptr(tlm::tlm_generic_payload& trans,
+                            tlm::tlm_dmi& dmi)
+    {
+        uint64_t addr = trans.get_address();
+        if (!config.dmi_allowed || !contains(addr)) {
+            return false;
+        }
+        uint64_t page_start = (addr - start) & ~page_mask;
+        uint64_t page_end = std::min(page_start + page_mask, size - 1);
+        dmi.set_dmi_ptr(page(page_start, true));
+        dmi.set_start_address(start + page_start);
+        dmi.set_end_address(start + page_end);
+        if (page_reserved(page_start)) {
+            dmi.allow_read();
+        } else {
+            dmi.allow_read_write();
+        }
+        dmi.set_read_latency(config.read_latency);
+        dmi.set_write_latency(config.write_latency);
+        return true;
+    }
+
+    bool contains(uint64_t addr) const
+    {
+        return addr >= start && addr - start < size;
+    }
+
+    /** Is [addr, addr + len) within the memory? Empty ranges always are */
+    bool within(uint64_t addr, uint64_t len) const
+    {
+        return len == 0 || (contains(addr) && len <= size - (addr - start));
+    }
+
+    tlm::tlm_response_status access(tlm::tlm_generic_payload& trans)
+    {
+        uint64_t addr = trans.get_address();
+        unsigned len = trans.get_data_length();
+        unsigned width = trans.get_streaming_width();
+        if (width == 0 || width > len) {
+            width = len;
+        }
+        if (!contains(addr) || width > size - (addr - start)) {
+            return tlm::TLM_ADDRESS_ERROR_RESPONSE;
+        }
+        if (trans.is_read() == trans.is_write()) {
+            return tlm::TLM_OK_RESPONSE;    // TLM_IGNORE_COMMAND
+        }
+
+        uint64_t offset = addr - start;
+        if (auto amo = trans.get_extension<AmoExtension>()) {
+            return atomic_access(trans, *amo, offset);
+        }
+
+        bool write = trans.is_write();
+        unsigned char* data = trans.get_data_ptr();
+        unsigned char* be = trans.get_byte_enable_ptr();
+        unsigned be_len = trans.get_byte_enable_length();
+        if (!be && width == len) {
+            copy(offset, data, len, write);
+        } else {
+            for (unsigned i = 0; i < len; i++) {
+                if (be && be[i % be_len] != tlm::TLM_BYTE_ENABLED) {
+                    continue;
+                }
+                copy(offset + i % width, data + i, 1, write);
+            }
+        }
+        if (write && !reservations.empty()) {
+            clear_reservations(offset, width);
+        }
+        return tlm::TLM_OK_RESPONSE;
+    }
+
+    /** AMO or LR/SC, which must not cross a page */
+    tlm::tlm_response_status atomic_access(tlm::tlm_generic_payload& trans,
+                                           AmoExtension& amo,
+                                           uint64_t offset)
+    {
+        unsigned len = trans.get_data_length();
+        if ((offset & page_mask) + len > page_size) {
+            return tlm::TLM_GENERIC_ERROR_RESPONSE;
+        }
+        unsigned char* data = trans.get_data_ptr();
+        uint64_t granule = offset >> config.reservation_bits;
+
+        if (amo.op == AMO_LOAD_RESERVED) {
+            copy(offset, data, len, false);
+            if (!page_reserved(offset & ~page_mask) && config.dmi_allowed) {
+                // revoke write DMI to the page
+                uint64_t page_start = offset & ~page_mask;
+                tsock->invalidate_direct_mem_ptr(start + page_start,
+                    start + std::min(page_start + page_mask, size - 1));
+            }
+            reservations[amo.reservation_id] = granule;
+        } else if (amo.op == AMO_STORE_CONDITIONAL) {
+            auto it = reservations.find(amo.reservation_id);
+            amo.sc_success = it != reservations.end() && it->second == granule;
+            reservations.erase(amo.reservation_id);
+            if (amo.sc_success) {
+                copy(offset, data, len, true);
+                clear_reservations(offset, len);
+            }
+        } else {
+            amo.execute(page(offset, true) + (offset & page_mask), data, len);
+            clear_reservations(offset, len);
+        }
+        amo.executed = true;
+        return tlm::TLM_OK_RESPONSE;
+    }
+
+    /** Drop the reservations of the granules overlapping a write */
+    void clear_reservations(uint64_t offset, uint64_t len)
+    {
+        uint64_t first = offset >> config.reservation_bits;
+        uint64_t last = (offset + len - 1) >> config.reservation_bits;
+        for (auto it = reservations.begin(); it != reservations.end();) {
+            if (it->second >= first && it->second <= last) {
+                it = reservations.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    bool page_reserved(uint64_t page_start) const
+    {
+        for (auto& r : reservations) {
+            if (((r.second << config.reservation_bits) & ~page_mask) ==
+                page_start) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /** Copy between data and [offset, offset + len), page by page */
+    void copy(uint64_t offset, unsigned char* data, uint64_t len, bool write)
+    {
+        while (len) {
+            uint64_t in_page = offset & page_mask;
+            uint64_t chunk = std::min(len, page_size - in_page);
+            uint8_t* p = page(offset, write);
+            if (write) {
+                std::memcpy(p + in_page, data, chunk);
+            } else if (p) {
+                std::memcpy(data, p + in_page, chunk);
+            } else {
+                std::memset(data, 0, chunk);
+            }
+            offset += chunk;
+            data += chunk;
+            len -= chunk;
+        }
+    }
+
+    /**
+     * Host memory of the page holding offset. Untouched pages are
+     * allocated zeroed if allocate is set, nullptr is returned otherwise.
+     */
+    uint8_t* page(uint64_t offset, bool allocate)
+    {
+        uint64_t index = offset >> config.page_bits;
+        if (last_page && index == last_index) {
+            return last_page;
+        }
+        auto it = pages.find(index);
+        if (it == pages.end()) {
+            if (!allocate) {
+                return nullptr;
+            }
+            uint8_t* p;
+            if (mapping) {
+                p = mapping + (index << config.page_bits);
+            } else {
+                heap_pages.emplace_back(new uint8_t[page_size]());
+                p = heap_pages.back().get();
+            }
+            it = pages.emplace(index, p).first;
+        }
+        last_index = index;
+        last_page = it->second;
+        return last_page;
+    }
+
+    void clear_pages()
+    {
+        pages.clear();
+        heap_pages.clear();
+        last_page = nullptr;
+    }
+
+    uint64_t mapping_size() const
+    {
+        return (size + page_mask) & ~page_mask;
+    }
+
+    /**
+     * Call f with the offset of every page overlapping a data extent of
+     * the first len bytes of fd. Holes are skipped where the file system
+     * reports them.
+     */
+    template <typename F>
+    void for_each_data_page(int fd, uint64_t len, F f)
+    {
+        off_t pos = 0;
+        while (uint64_t(pos) < len) {
+            off_t data = ::lseek(fd, pos, SEEK_DATA);
+            if (data < 0 || uint64_t(data) >= len) {
+                break;
+            }
+            off_t hole = ::lseek(fd, data, SEEK_HOLE);
+            uint64_t end = hole < 0 ? len : std::min(uint64_t(hole), len);
+            for (uint64_t p = data & ~page_mask; p < end; p += page_size) {
+                f(p);
+            }
+            pos = end;
+        }
+    }
+
+    /**
+     * (Re)map the whole range: an anonymous reservation with the file
+     * mapped copy-on-write over its start.
+     */
+    bool map_file(const std::string& path)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        struct stat st;
+        if (fd < 0 || ::fstat(fd, &st) != 0) {
+            if (fd >= 0) {
+                ::close(fd);
+            }
+            return false;
+        }
+        uint64_t len = std::min(uint64_t(st.st_size), size);
+        clear_pages();
+
+        void* p = ::mmap(mapping, mapping_size(), PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE |
+                         (mapping ? MAP_FIXED : 0), -1, 0);
+        bool ok = p != MAP_FAILED;
+        if (ok) {
+            mapping = static_cast<uint8_t*>(p);
+            ok = len == 0 ||
+                 ::mmap(mapping, len, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_FIXED | MAP_NORESERVE, fd, 0) !=
+                     MAP_FAILED;
+        }
+        if (ok) {
+            for_each_data_page(fd, len, [this](uint64_t offset) {
+                pages.emplace(offset >> config.page_bits, mapping + offset);
+            });
+        }
+        ::close(fd);
+        return ok;
+    }
+
+    /** Read the data extents of a raw image into fresh heap pages */
+    bool load_file(const std::string& path)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        struct stat st;
+        if (fd < 0 || ::fstat(fd, &st) != 0) {
+            if (fd >= 0) {
+                ::close(fd);
+            }
+            return false;
+        }
+        uint64_t len = std::min(uint64_t(st.st_size), size);
+        clear_pages();
+
+        bool ok = true;
+        for_each_data_page(fd, len, [&](uint64_t offset) {
+            uint64_t n = std::min(page_size, len - offset);
+            ok = ok && ::pread(fd, page(offset, true), n, offset) == ssize_t(n);
+        });
+        ::close(fd);
+        return ok;
+    }
+
+    static bool write_all(int fd, const uint8_t* data, uint64_t len,
+                          uint64_t offset)
+    {
+        while (len) {
+            ssize_t n = ::pwrite(fd, data, len, offset);
+            if (n <= 0) {
+                return false;
+            }
+            data += n;
+            len -= n;
+            offset += n;
+        }
+        return true;
+    }
+
+    const uint64_t start;
+    const uint64_t size;
+    SparseMemoryConfig config;
+    const uint64_t page_size;
+    const uint64_t page_mask;
+
+    // pages holding data, by page index
+    std::unordered_map<uint64_t, uint8_t*> pages;
+    uint64_t last_index = 0;
+    uint8_t* last_page = nullptr;
+    // without backing file: storage of the pages
+    std::vector<std::unique_ptr<uint8_t[]>> heap_pages;
+    // with backing file: mapping of the whole range
+    uint8_t* mapping = nullptr;
+    // LR/SC: reserved granule by reservation id
+    std::unordered_map<uint64_t, uint64_t> reservations;
+};
+
+} // namespace Gem5SystemC
+
+#endif
@@ -13,35 +13,131 @@
  * whether one is a memory transaction or not. Non-memory transactions can be
  * DMA register configurations, CLINT events and so on. It helps to integrate
  * CHI modules without messing the VP itself and the CHI library.
+ *
+ * Routing is done through an address map. Each region is bound to one of
+ * the initiator sockets and lists the access modes (timing, blocking,
+ * debug) it accepts. Accesses that miss the map, or hit a region that does
+ * not accept their mode, take the default route. The constructor sets up
+ * the classic layout: the memory window goes to isock_mem for timing and
+ * blocking accesses, everything else is sent to isock_bus.
+ *
+ * Two behaviours differ from the router before the address map:
+ *  - debug accesses outside the memory window take the default route to
+ *    isock_bus like those inside it, instead of being fatal; an access no
+ *    route accepts is still fatal
+ *  - blocking accesses keep the response status the target set, only an
+ *    untouched TLM_INCOMPLETE_RESPONSE is turned into TLM_OK_RESPONSE
+ *    (memory accesses used to be forced to TLM_OK_RESPONSE)
+ *
+ * DMI requests follow the blocking route. The granted region is clipped to
+ * the region the address was routed by (or to the unmapped gap around it
+ * for the default route), and invalidations from any port are passed on
+ * to tsock.
+ *
+ * Debug tracing is selected at compile time. Without TXN_ROUTER_TRACE the
+ * TXN_TRACE() hooks compile to nothing. With it, every callback appends a
+ * binary record, time stamped in time resolution ticks, to an in-memory
+ * ring buffer, which is dumped to <name>.txntrace together with the time
+ * resolution at the end of simulation when the router was created with
+ * debug set. Use util/txn_trace_decode to turn the dump into text.
  */
 
 #ifndef TXN_ROUTER_H
 #define TXN_ROUTER_H
 
-#include <iostream>
-#include <iomanip>
+#include <algorithm>
 #include <tlm_utils/peq_with_cb_and_phase.h>
 #include <tlm_utils/simple_initiator_socket.h>
 #include <tlm_utils/simple_target_socket.h>
 
 #include <systemc>
 
+#include "address_map.h"
+#include "dmi_util.h"
+#include "host_time.h"
+#include "txn_trace.h"
+
 using namespace sc_core;
 using namespace sc_dt;
+
+#ifdef TXN_ROUTER_TRACE
+#define TXN_TRACE(event, trans) \
+    trace.record(sc_core::sc_time_stamp().value(), event, \
+                 (trans).get_address(), (trans).get_data_length(), \
+                 (trans).get_command())
+#else
+#define TXN_TRACE(event, trans) do { } while (0)
+#endif
 namespace Gem5SystemC
 {
 
+/**
+ * Timing parameters of a TxnRouter. The defaults reproduce the fixed delays
+ * of the original router, so a default constructed config does not change
+ * the timing of existing platforms.
+ */
+struct TxnRouterConfig
+{
+    /** Delay annotated on END_REQ, i.e. the time to accept a request */
+    sc_core::sc_time accept_delay = sc_core::sc_time(10.0, sc_core::SC_NS);
+    /**
+     * Minimum interval between two accepted requests. This is the inverse
+     * of the request acceptance rate, zero means unlimited.
+     */
+    sc_core::sc_time accept_interval = sc_core::SC_ZERO_TIME;
+    /** Time between END_REQ and forwarding the request downstream */
+    sc_core::sc_time forward_latency = sc_core::sc_time(15.0, sc_core::SC_NS);
+    /** Delay handed to the downstream b_transport call */
+    sc_core::sc_time downstream_delay = sc_core::sc_time(10.0, sc_core::SC_NS);
+    /**
+     * Add the delay returned by the downstream b_transport call to
+     * BEGIN_RESP, so the latency of a timed target such as DramTiming
+     * shows up in the response. By default the returned delay is ignored.
+     */
+    bool honor_downstream_delay = false;
+    /** Delay annotated on BEGIN_RESP */
+    sc_core::sc_time response_latency = sc_core::sc_time(10.0, sc_core::SC_NS);
+    /**
+     * Bandwidth of the response channel in bytes per second. Read data is
+     * serialised on this channel, so back-to-back responses queue up behind
+     * each other. Zero means unlimited.
+     */
+    double response_bandwidth = 0.0;
+    /** Number of initiator sockets in addition to isock_mem and isock_bus */
+    unsigned extra_ports = 0;
+    /**
+     * Early completion: if the router is idle when a timing request
+     * arrives, execute it right away and answer BEGIN_REQ with
+     * TLM_UPDATED/BEGIN_RESP and the accumulated delay. This collapses the
+     * END_REQ/BEGIN_RESP handshake into a single call and is meant for
+     * blocking (LT) models behind the router, which get the time the
+     * request would have been forwarded at as b_transport delay.
+     */
+    bool early_completion = false;
+};
+
+/** Access modes a TxnRouter region can accept, may be or'ed together */
+enum TxnAccessMode : unsigned
+{
+    ACCESS_TIMING   = 1 << 0,   // nb_transport
+    ACCESS_BLOCKING = 1 << 1,   // b_transport
+    ACCESS_DEBUG    = 1 << 2,   // transport_dbg
+    ACCESS_ALL      = ACCESS_TIMING | ACCESS_BLOCKING | ACCESS_DEBUG
+};
+
 class TxnRouter : public sc_core::sc_module
 {
 public:
     TxnRouter(sc_core::sc_module_name,
               uint64_t mem_start_addr_,
               uint64_t mem_size_,
-              bool debug_)
-        : mem_start_addr(mem_start_addr_),
-        mem_size(mem_size_),
+              bool debug_,
+              const TxnRouterConfig& config_ = TxnRouterConfig())
+        : isocks("isock"),
         debug(debug_),
+        config(config_),
         m_peq(this, &TxnRouter::peq_cb),
+        m_exec_peq(this, &TxnRouter::execute_cb),
         transaction_in_progress(0),
         response_in_progress(false),
         next_response_pending(0),
@@ -50,75 +146,175 @@ public:
         tsock.register_b_transport(this, &TxnRouter::b_transport);
         tsock.register_transport_dbg(this, &TxnRouter::transport_dbg);
         tsock.register_nb_transport_fw(this, &TxnRouter::nb_transport_fw);
+        tsock.register_get_direct_mem_ptr(this, &TxnRouter::get_direct_mem_ptr);
         isock_mem.register_nb_transport_bw(this, &TxnRouter::nb_transport_bw_resp);
+        isock_mem.register_invalidate_direct_mem_ptr(this,
+                                        &TxnRouter::invalidate_direct_mem_ptr);
+        isock_bus.register_invalidate_direct_mem_ptr(this,
+                                        &TxnRouter::invalidate_direct_mem_ptr);
+        isocks.init(config.extra_ports);
+        for (unsigned i = 0; i < isocks.size(); i++) {
+            isocks[i].register_nb_transport_bw(this,
+                                        &TxnRouter::nb_transport_bw_resp);
+            isocks[i].register_invalidate_direct_mem_ptr(this,
+                                        &TxnRouter::invalidate_direct_mem_ptr);
+        }
 
-        SC_THREAD(execute_transaction_process);
+        if (mem_size_ > 0) {
+            add_region(mem_start_addr_, mem_size_, PORT_MEM,
+                       ACCESS_TIMING | ACCESS_BLOCKING);
+        }
+        set_default_route(PORT_BUS, ACCESS_BLOCKING | ACCESS_DEBUG);
 
     }
     SC_HAS_PROCESS(TxnRouter);
 
-private:
-    void b_transport(tlm::tlm_generic_payload &trans, sc_core::sc_time &delay)
+#ifdef TXN_ROUTER_TRACE
+    void end_of_simulation() override
     {
-        // receive Atomic request from gem5 world
         if (debug) {
-            SC_REPORT_INFO(this->name(), "b_transport ");
+            trace.dump(std::string(this->name()) + ".txntrace",
+                       uint64_t(sc_core::sc_get_time_resolution()
+                                    .to_seconds() * 1e15 + 0.5));
         }
+    }
+#endif
 
-        if (ToMem(trans)) {
-            if (debug){
-                SC_REPORT_INFO(this->name(), "receive mem request");
-            }
-            isock_mem->b_transport(trans, delay);
-            trans.set_response_status(tlm::TLM_OK_RESPONSE);
-            //execute_transaction(trans);
+    /** Port ids of the fixed sockets, extra sockets follow from PORT_EXTRA */
+    static constexpr unsigned PORT_MEM = 0;
+    static constexpr unsigned PORT_BUS = 1;
+    static constexpr unsigned PORT_EXTRA = 2;
+
+    /**
+     * Route [start, start + size) to the given port for the given access
+     * modes. Regions must not overlap.
+     */
+    void add_region(uint64_t start, uint64_t size, unsigned port,
+                    unsigned modes)
+    {
+        if (port >= PORT_EXTRA + isocks.size()) {
+            SC_REPORT_FATAL(this->name(), "Region bound to unknown port");
         }
-        else {
-            if (debug) {
-               SC_REPORT_INFO(this->name(), "receive to mem request ");
-            }
-            isock_bus->b_transport(trans, delay);
+        if (size == 0 ||
+            !regions.insert(start, start + size - 1, Route{port, modes})) {
+            SC_REPORT_FATAL(this->name(), "Invalid or overlapping region");
         }
     }
 
+    /** Route for accesses which are not covered by any region */
+    void set_default_route(unsigned port, unsigned modes)
+    {
+        default_route = Route{port, modes};
+    }
+
+    /** Initiator socket of a port id */
+    tlm_utils::simple_initiator_socket<TxnRouter>& port(unsigned id)
+    {
+        switch (id) {
+          case PORT_MEM:
+            return isock_mem;
+          case PORT_BUS:
+            return isock_bus;
+          default:
+            return isocks[id - PORT_EXTRA];
+        }
+    }
+
+private:
+    struct Route
+    {
+        unsigned port;
+        unsigned modes;
+    };
+
+    /** Port id for an access to addr in the given mode, -1 if none */
+    int route(uint64_t addr, unsigned mode) const
+    {
+        auto region = regions.find(addr);
+        if (region && (region->value.modes & mode)) {
+            return region->value.port;
+        }
+        if (default_route.modes & mode) {
+            return default_route.port;
+        }
+        return -1;
+    }
+
+    void b_transport(tlm::tlm_generic_payload &trans, sc_core::sc_time &delay)
+    {
+        // receive Atomic request from gem5 world
+        int id = route(trans.get_address(), ACCESS_BLOCKING);
+        if (id < 0) {
+            trans.set_response_status(tlm::TLM_ADDRESS_ERROR_RESPONSE);
+            return;
+        }
+        TXN_TRACE(TXN_EV_B_TRANSPORT, trans);
+        port(id)->b_transport(trans, delay);
+        set_default_response(trans);
+    }
+
     unsigned int transport_dbg(tlm::tlm_generic_payload &trans)
     {
+        HostTimeScope host_time(HOST_TIME_INTERCONNECT);
         // recvFunctional request from gem5 world
         // used for loading the binary (recvFunctional)
         // send to the memory directly
-        if (debug){
-            //SC_REPORT_INFO(this->name(), "transport_dbg");
+        // By default memory is reached through the SimpleBus
+        int id = route(trans.get_address(), ACCESS_DEBUG);
+        if (id < 0) {
+            SC_REPORT_FATAL("TXN_ROUTER", "Address out of range. Please check");
+            return 0;
         }
-        if (ToMem(trans)) {
-            if (debug) {
-                //SC_REPORT_INFO(this->name(), "receive Functional request ");
-            }
-            // Using SimpleBus to access memory
-            return isock_bus->transport_dbg(trans);
+        TXN_TRACE(TXN_EV_TRANSPORT_DBG, trans);
+        return port(id)->transport_dbg(trans);
+    }
+
+    bool get_direct_mem_ptr(tlm::tlm_generic_payload& trans,
+                            tlm::tlm_dmi& dmi)
+    {
+        uint64_t addr = trans.get_address();
+        int id = route(addr, ACCESS_BLOCKING);
+        if (id < 0) {
+            return false;
         }
-        else {
-            SC_REPORT_FATAL("TXN_ROUTER", "Address out of range. Please check");
+        TXN_TRACE(TXN_EV_GET_DMI, trans);
+        bool granted = port(id)->get_direct_mem_ptr(trans, dmi);
+
+        uint64_t start, end;
+        if (auto region = regions.find(addr)) {
+            start = region->start;
+            end = region->end;
+        } else {
+            regions.gap(addr, start, end);
         }
-        return 0;
+        clip_dmi(dmi, start, end);
+        return granted;
+    }
+
+    void invalidate_direct_mem_ptr(sc_dt::uint64 start, sc_dt::uint64 end)
+    {
+        tsock->invalidate_direct_mem_ptr(start, end);
     }
 
     tlm::tlm_sync_enum nb_transport_fw(tlm::tlm_generic_payload& trans,
                 tlm::tlm_phase& phase,
                 sc_time& delay)
     {
+        HostTimeScope host_time(HOST_TIME_INTERCONNECT);
         // receive TimingReq from gem5 world
-        if (debug) {
-            SC_REPORT_INFO(this->name(), "nb_transport_fw ");
-            std::cout<<  "Addr : " << std::setw(8) << std::hex
-                << trans.get_address() 
-                << " data_ptr: " << trans.get_data_ptr() 
-                << std::endl;
-        }
-        if (ToMem(trans)) {
-            if (debug) {
-                SC_REPORT_INFO(this->name(), " receive to mem request ");
-                std::cout << "Addr : " << std::setw(8) << std::hex
-                    << trans.get_address() << std::endl;
+        if (route(trans.get_address(), ACCESS_TIMING) >= 0) {
+            TXN_TRACE(phase == tlm::END_RESP ? TXN_EV_FW_END_RESP
+                                             : TXN_EV_FW_REQ, trans);
+            if (phase == tlm::END_RESP && &trans == early_response) {
+                // nothing is waiting for this in the PEQ, finish it here
+                early_response = 0;
+                end_response();
+                return tlm::TLM_COMPLETED;
+            }
+            if (phase == tlm::BEGIN_REQ && config.early_completion &&
+                is_idle()) {
+                complete_early(trans, phase, delay);
+                return tlm::TLM_UPDATED;
             }
             m_peq.notify(trans, phase, delay);
         }
@@ -132,20 +328,18 @@ private:
                 tlm::tlm_phase& phase,
                 sc_time& delay)
     {
-        if (debug){
-             SC_REPORT_INFO(this->name(), "nb_transport_bw_resp ");
-        }
         return tlm::TLM_ACCEPTED;
     }
 
-    // same as check_address in sc_target
-    bool ToMem(tlm::tlm_generic_payload& trans) {
-        auto addr = trans.get_address();
-        if (addr < mem_start_addr)
-            return false;
-        if (addr >= mem_start_addr + mem_size)
-            return false;
-        return true;
+    /**
+     * Downstream models do not always set a response status. Treat an
+     * untouched status as success, but keep errors reported by the target.
+     */
+    void set_default_response(tlm::tlm_generic_payload& trans)
+    {
+        if (trans.get_response_status() == tlm::TLM_INCOMPLETE_RESPONSE) {
+            trans.set_response_status(tlm::TLM_OK_RESPONSE);
+        }
     }
 
     /* Helping functions and processes */
@@ -159,13 +353,9 @@ private:
 
         response_in_progress = true;
         bw_phase = tlm::BEGIN_RESP;
-        delay = sc_time(10.0, SC_NS);
-        if (debug){
-           std::cout << sc_time_stamp() << " " << this->name()
-                << " send response addr: " << std::setw(8) << std::hex
-                << trans.get_address() << std::endl;
-           std::cout << "data_ptr: " << trans.get_data_ptr() << std::endl;
-        }
+        delay = downstream_time + config.response_latency +
+                response_channel_delay(trans);
+        TXN_TRACE(TXN_EV_BEGIN_RESP, trans);
         status = tsock->nb_transport_bw( trans, bw_phase, delay );
 
         if (status == tlm::TLM_UPDATED) {
@@ -183,14 +373,10 @@ private:
     void peq_cb(tlm::tlm_generic_payload& trans,
                 const tlm::tlm_phase& phase)
     {
+        HostTimeScope host_time(HOST_TIME_INTERCONNECT);
         sc_time delay;
 
         if (phase == tlm::BEGIN_REQ) {
-            if (debug) {
-                SC_REPORT_INFO(this->name(), " Begin request");
-                std::cout << "Addr : " << std::setw(8) << std::hex <<
-                    trans.get_address() << std::endl;
-            }
             trans.acquire();
             if (!transaction_in_progress) {
                 send_end_req(trans);
@@ -202,118 +388,163 @@ private:
         }else if (phase == tlm::END_RESP) {
             /* On receiving END_RESP, the target can release the transaction and
             * allow other pending transactions to proceed */
-            if (debug) {
-                SC_REPORT_INFO(this->name(), "end response");
-                std::cout << "Addr : " << std::setw(8) << std::hex <<
-                    trans.get_address() << std::endl;
-                if (trans.get_data_ptr()){
-                    std::cout << "data_ptr : " << trans.get_data_ptr() << std::endl;
-                }
-                
-            }
-            if (!response_in_progress){
-                SC_REPORT_FATAL(this->name(), "Illegal transaction phase END RESP");
-            }
-
-            transaction_in_progress = 0;
-
-            // ready to issue the next BEGIN_RESP
-            response_in_progress = false;
-            if (next_response_pending) {
-                send_response( *next_response_pending );
-                next_response_pending = 0;
-            }
-
-            /* ... and to unblock the initiator by issuing END_REQ */
-            if (end_req_pending) {
-                if (debug){
-                    std::cout << sc_time_stamp()
-                        << this->name()
-                        << " end_req_pending addr: "
-                        << std::setw(8) << std::hex
-                        << end_req_pending->get_address()
-                        << std::endl;
-                }
-                send_end_req( *end_req_pending );
-                end_req_pending = 0;
-            }
+            end_response();
         } else  //tlm::END_REQ or tlm::BEGIN_RESP
         {
             SC_REPORT_FATAL(this->name() , "Illegal transaction phase");
         }
     }
 
-    void send_end_req(tlm::tlm_generic_payload& trans)
+    void end_response()
     {
-        if (debug) {
-            SC_REPORT_INFO(this->name(), "send_end_req");
-            std::cout << "Addr : " << std::setw(8) << std::hex
-                << trans.get_address() << std::endl;
+        if (!response_in_progress){
+            SC_REPORT_FATAL(this->name(), "Illegal transaction phase END RESP");
+        }
+
+        transaction_in_progress = 0;
+
+        // ready to issue the next BEGIN_RESP
+        response_in_progress = false;
+        if (next_response_pending) {
+            send_response( *next_response_pending );
+            next_response_pending = 0;
+        }
+
+        /* ... and to unblock the initiator by issuing END_REQ */
+        if (end_req_pending) {
+            send_end_req( *end_req_pending );
+            end_req_pending = 0;
         }
+    }
+
+    /** No transaction is in flight and nothing is queued */
+    bool is_idle() const
+    {
+        return !transaction_in_progress && !response_in_progress &&
+               !next_response_pending && !end_req_pending;
+    }
+
+    /**
+     * Early completion of a BEGIN_REQ: the transaction is executed
+     * immediately, at the time it would have been forwarded, and the
+     * delays of the request (BEGIN_REQ annotation, acceptance, forwarding),
+     * the target and BEGIN_RESP are accumulated into the annotated delay.
+     * The caller returns TLM_UPDATED with phase BEGIN_RESP. The response is
+     * in progress until END_RESP arrives, so requests meanwhile take the
+     * regular path.
+     */
+    void complete_early(tlm::tlm_generic_payload& trans,
+                        tlm::tlm_phase& phase, sc_time& delay)
+    {
+        TXN_TRACE(TXN_EV_EARLY_RESP, trans);
+        delay += config.accept_delay + acceptance_delay(delay) +
+                 config.forward_latency;
+        execute_transaction(trans, delay);
+        delay += downstream_time + config.response_latency +
+                 response_channel_delay(trans, delay);
+
+        transaction_in_progress = &trans;
+        response_in_progress = true;
+        early_response = &trans;
+        phase = tlm::BEGIN_RESP;
+    }
+
+    void send_end_req(tlm::tlm_generic_payload& trans)
+    {
+        TXN_TRACE(TXN_EV_END_REQ, trans);
         tlm::tlm_phase bw_phase;
         sc_time delay;
 
         bw_phase = tlm::END_REQ;
-        delay = sc_time(10.0, SC_NS);
+        delay = config.accept_delay + acceptance_delay();
 
-        tlm::tlm_sync_enum status;
-        status = tsock->nb_transport_bw(trans, bw_phase, delay);
-        if (debug) {
-            std::cout <<  sc_time_stamp() << " " << this->name()
-                << " send_end_req nb_transport_bw "
-                <<" addr: " << std::setw(8) << std::hex
-                << trans.get_address() << std::endl;
-        }
-        delay = delay + sc_time(15.0, SC_NS); // latency
-        target_done_event.notify(delay);
+        tsock->nb_transport_bw(trans, bw_phase, delay);
+        delay = delay + config.forward_latency;
+        m_exec_peq.notify(trans, tlm::BEGIN_REQ, delay);
 
         assert(transaction_in_progress == 0);
         transaction_in_progress = &trans;
 
     }
 
-    void execute_transaction_process(){
-        while (true){
-            wait(target_done_event);
-            if (debug) {
-                SC_REPORT_INFO(this->name(), "execute transaction process");
-                std::cout << std::setw(8) << std::hex
-                    << "Addr : " << transaction_in_progress->get_address()
-                    << std::endl;
-            }
-            // Execute the read or write commands
-            // In this case , forward to next IP by isock_mem;
-            execute_transaction(*transaction_in_progress); // TODO
+    /**
+     * Callback of the execution PEQ, fires once the forwarding latency of
+     * the accepted transaction has passed. The PEQ runs its callbacks from
+     * a method process, so no thread context switch is needed per
+     * transaction.
+     */
+    void execute_cb(tlm::tlm_generic_payload& trans,
+                    const tlm::tlm_phase& phase)
+    {
+        HostTimeScope host_time(HOST_TIME_INTERCONNECT);
+        sc_assert(&trans == transaction_in_progress);
+        // Execute the read or write commands
+        // In this case , forward to next IP by the port of the region;
+        execute_transaction(trans);
 
-            if (response_in_progress)
-            {
-                /* Target allows only two transactions in-flight */
-                if (next_response_pending)
-                {
-                    SC_REPORT_FATAL("TLM-2", "Attempt to have two pending "
-                                "responses in target");
-                }
-                next_response_pending = transaction_in_progress;
-            }
-            else
+        if (response_in_progress)
+        {
+            /* Target allows only two transactions in-flight */
+            if (next_response_pending)
             {
-                send_response(*transaction_in_progress);  // TODO
+                SC_REPORT_FATAL("TLM-2", "Attempt to have two pending "
+                            "responses in target");
             }
+            next_response_pending = &trans;
+        }
+        else
+        {
+            send_response(trans);
         }
     }
 
-    void execute_transaction(tlm::tlm_generic_payload& trans)
+    /**
+     * Forward the transaction to the port of its region, offset ahead of
+     * the current time. downstream_time is the delay the target added.
+     */
+    void execute_transaction(tlm::tlm_generic_payload& trans,
+                             sc_time offset = SC_ZERO_TIME)
     {
-        // Forward the transaction to next component
-        if (debug) {
-            SC_REPORT_INFO(this->name(), " execute transaction");
-            std::cout << std::setw(8) << std::hex << "Addr : "
-                << trans.get_address() << std::endl;
+        TXN_TRACE(TXN_EV_EXECUTE, trans);
+        sc_time delay = offset + config.downstream_delay;
+        port(route(trans.get_address(), ACCESS_TIMING))->b_transport(trans,
+                                                                     delay);
+        downstream_time = config.honor_downstream_delay && delay > offset
+                        ? delay - offset : SC_ZERO_TIME;
+        set_default_response(trans);
+    }
+
+    /**
+     * Time a new request has to wait until the router may accept it, given
+     * the configured acceptance rate, for a request arriving offset after
+     * the current time. Reserves the acceptance slot.
+     */
+    sc_time acceptance_delay(sc_time offset = SC_ZERO_TIME)
+    {
+        sc_time now = sc_time_stamp() + offset;
+        sc_time start = std::max(now, next_accept_time);
+        next_accept_time = start + config.accept_interval;
+        return start - now;
+    }
+
+    /**
+     * Queueing model of the response channel: the read data of a response
+     * can only start once the data of the previous one has been sent.
+     * Returns the delay until the data of this response has been sent, for
+     * a response ready offset after the current time.
+     */
+    sc_time response_channel_delay(tlm::tlm_generic_payload& trans,
+                                   sc_time offset = SC_ZERO_TIME)
+    {
+        if (config.response_bandwidth <= 0.0 || !trans.is_read()) {
+            return SC_ZERO_TIME;
         }
-        sc_time delay;
-        delay = sc_time(10.0, SC_NS);
-        isock_mem->b_transport(trans, delay);
-        trans.set_response_status(tlm::TLM_OK_RESPONSE);
+        sc_time now = sc_time_stamp() + offset;
+        sc_time start = std::max(now, response_channel_free);
+        sc_time transfer(trans.get_data_length() / config.response_bandwidth,
+                         SC_SEC);
+        response_channel_free = start + transfer;
+        return response_channel_free - now;
     }
 
 
@@ -322,18 +553,37 @@ public:
     tlm_utils::simple_target_socket<TxnRouter> tsock;
     tlm_utils::simple_initiator_socket<TxnRouter> isock_mem;
     tlm_utils::simple_initiator_socket<TxnRouter> isock_bus;
+    // additional ports for devices, further memory channels and so on
+    sc_core::sc_vector<tlm_utils::simple_initiator_socket<TxnRouter>> isocks;
 
+private:
+    // with TXN_ROUTER_TRACE: dump the trace at the end of simulation
+    bool debug;
+    TxnRouterConfig config;
+
+public:
     tlm_utils::peq_with_cb_and_phase<TxnRouter> m_peq;
+    // accepted transactions waiting for the forwarding latency
+    tlm_utils::peq_with_cb_and_phase<TxnRouter> m_exec_peq;
     tlm::tlm_generic_payload*  transaction_in_progress;
-    sc_event                   target_done_event;
     bool                       response_in_progress;
     tlm::tlm_generic_payload*  next_response_pending;
     tlm::tlm_generic_payload*  end_req_pending;
+    // response sent by early completion, waiting for END_RESP
+    tlm::tlm_generic_payload*  early_response = 0;
 
 private:
-    uint64_t mem_start_addr;
-    uint64_t mem_size;
-    bool debug;
+#ifdef TXN_ROUTER_TRACE
+    TxnTraceBuffer trace;
+#endif
+
+    sc_time next_accept_time;
+    sc_time response_channel_free;
+    // delay returned downstream for the executed transaction, if honored
+    sc_time downstream_time;
+
+    AddressMap<Route> regions;
+    Route default_route = Route{PORT_BUS, 0};
 
 };
 } // namespace Gem5SystemC
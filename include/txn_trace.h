@@ -0,0 +1,175 @@
+/**
+ * @file txn_trace.h
+ * @brief In-memory binary transaction trace of the SystemC interconnect
+ *
+ * A TxnTraceBuffer is a fixed size ring buffer of compact binary records.
+ * Recording a transaction costs a few stores and never allocates, so the
+ * trace can stay compiled in for production runs. The buffer keeps the most
+ * recent records and is written to a file on request; decode() turns such a
+ * file back into text (see util/txn_trace_decode.cc).
+ *
+ * This header deliberately depends on the C++ standard library only, so the
+ * offline decoder can be built without SystemC and gem5.
+ */
+
+#ifndef TXN_TRACE_H
+#define TXN_TRACE_H
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+
+namespace Gem5SystemC
+{
+
+/** Events recorded by the TxnRouter */
+enum TxnTraceEvent : uint8_t
+{
+    TXN_EV_B_TRANSPORT,     // blocking access forwarded
+    TXN_EV_TRANSPORT_DBG,   // debug access forwarded
+    TXN_EV_FW_REQ,          // BEGIN_REQ received
+    TXN_EV_FW_END_RESP,     // END_RESP received
+    TXN_EV_END_REQ,         // END_REQ sent
+    TXN_EV_EXECUTE,         // forwarded downstream in timing mode
+    TXN_EV_BEGIN_RESP,      // BEGIN_RESP sent
+    TXN_EV_EARLY_RESP,      // BEGIN_REQ answered by early completion
+    TXN_EV_GET_DMI,         // DMI request forwarded
+    TXN_EV_NUM
+};
+
+struct TxnTraceRecord
+{
+    uint64_t time;      // SystemC time stamp in time resolution ticks
+    uint64_t addr;
+    uint32_t length;
+    uint8_t event;      // TxnTraceEvent
+    uint8_t command;    // tlm::tlm_command
+    uint16_t reserved;
+};
+static_assert(sizeof(TxnTraceRecord) == 24, "unexpected trace record size");
+
+class TxnTraceBuffer
+{
+public:
+    /** The buffer holds 2^capacity_log2 records */
+    explicit TxnTraceBuffer(unsigned capacity_log2 = 16)
+        : mask((uint64_t(1) << capacity_log2) - 1),
+          records(new TxnTraceRecord[mask + 1]),
+          head(0)
+    {
+    }
+
+    void record(uint64_t time, uint8_t event, uint64_t addr,
+                uint32_t length, uint8_t command)
+    {
+        TxnTraceRecord& r = records[head & mask];
+        r.time = time;
+        r.addr = addr;
+        r.length = length;
+        r.event = event;
+        r.command = command;
+        r.reserved = 0;
+        head++;
+    }
+
+    /** Number of records recorded in total, including overwritten ones */
+    uint64_t recorded() const { return head; }
+
+    /**
+     * Write the buffered records, oldest first. The time resolution in fs
+     * goes into the file header, so the decoder can print ps. Returns false
+     * on error
+     */
+    bool dump(const std::string& path, uint64_t resolution_fs) const
+    {
+        std::ofstream out(path, std::ios::binary);
+        if (!out) {
+            return false;
+        }
+        uint64_t capacity = mask + 1;
+        uint64_t count = head < capacity ? head : capacity;
+        FileHeader header;
+        std::memcpy(header.magic, fileMagic, sizeof(header.magic));
+        header.recordSize = sizeof(TxnTraceRecord);
+        header.count = count;
+        header.dropped = head - count;
+        header.resolutionFs = resolution_fs;
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        for (uint64_t i = head - count; i < head; i++) {
+            out.write(reinterpret_cast<const char*>(&records[i & mask]),
+                      sizeof(TxnTraceRecord));
+        }
+        return bool(out);
+    }
+
+    /**
+     * Decode a file written by dump() into one line of text per record,
+     * with the time in ps
+     */
+    static bool decode(std::istream& in, std::ostream& out)
+    {
+        static const char* const eventNames[TXN_EV_NUM] = {
+            "b_transport", "transport_dbg", "BEGIN_REQ", "END_RESP",
+            "END_REQ", "execute", "BEGIN_RESP", "early_resp", "get_dmi"
+        };
+        static const char* const commandNames[] = { "R", "W", "-" };
+
+        FileHeader header;
+        if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+            std::memcmp(header.magic, fileMagic, sizeof(header.magic)) != 0 ||
+            header.recordSize != sizeof(TxnTraceRecord) ||
+            header.resolutionFs == 0) {
+            return false;
+        }
+        // a resolution below 1 ps gives fractional ps
+        const bool fractional = header.resolutionFs % 1000 != 0;
+        if (header.dropped) {
+            out << "# " << header.dropped << " older records dropped\n";
+        }
+        TxnTraceRecord r;
+        for (uint64_t i = 0; i < header.count; i++) {
+            if (!in.read(reinterpret_cast<char*>(&r), sizeof(r))) {
+                return false;
+            }
+            out << std::dec << std::setw(16);
+            if (fractional) {
+                out << std::fixed << std::setprecision(3)
+                    << r.time * (header.resolutionFs / 1000.0);
+            } else {
+                out << r.time * (header.resolutionFs / 1000);
+            }
+            out << " "
+                << std::setw(13) << std::left
+                << (r.event < TXN_EV_NUM ? eventNames[r.event] : "?")
+                << std::right << " "
+                << (r.command < 3 ? commandNames[r.command] : "?")
+                << " 0x" << std::hex << std::setw(16) << std::setfill('0')
+                << r.addr << std::setfill(' ') << std::dec
+                << " " << r.length << "\n";
+        }
+        return true;
+    }
+
+private:
+    struct FileHeader
+    {
+        char magic[8];
+        uint64_t recordSize;
+        uint64_t count;
+        uint64_t dropped;
+        uint64_t resolutionFs;  // fs per tick of TxnTraceRecord::time
+    };
+    static constexpr char fileMagic[8] = {'T','X','N','T','R','C','0','2'};
+
+    const uint64_t mask;
+    std::unique_ptr<TxnTraceRecord[]> records;
+    uint64_t head;
+};
+
+} // namespace Gem5SystemC
+
+#endif
@@ -0,0 +1,85 @@
+/**
+ * @file write_overlay.h
+ * @brief Functional view of the writes SCSlavePort holds back
+ *
+ * Posted writes and write-combining lines are answered to gem5 before the
+ * SystemC target has seen them. Functional accesses and bypassed fetches
+ * read the target directly, so the pending data is laid over what they
+ * read, and functional writes update it.
+ *
+ * This header depends on the C++ standard library only, so it can be
+ * tested without SystemC and gem5.
+ */
+
+#ifndef WRITE_OVERLAY_H
+#define WRITE_OVERLAY_H
+
+#include <algorithm>
+#include <cstdint>
+
+namespace Gem5SystemC
+{
+
+/**
+ * Copy the bytes of a pending write [addr, addr + size) that overlap an
+ * access: into the access data for a read, from it for a write. Bytes
+ * whose byte_enable is zero (TLM_BYTE_DISABLED) are skipped, a null
+ * byte_enable enables all bytes.
+ */
+inline void
+overlayPendingWrite(uint64_t access_addr, uint8_t* access_data,
+                    unsigned access_size, bool read, uint64_t addr,
+                    uint8_t* data, const uint8_t* byte_enable, unsigned size)
+{
+    uint64_t start = std::max(access_addr, addr);
+    uint64_t end = std::min(access_addr + access_size, addr + size);
+    for (uint64_t a = start; a < end; a++) {
+        if (byte_enable && byte_enable[a - addr] == 0) {
+            continue;
+        }
+        if (read) {
+            access_data[a - access_addr] = data[a - addr];
+        } else {
+            data[a - addr] = access_data[a - access_addr];
+        }
+    }
+}
+
+/**
+ * Overlay the posted-write slots (busy, addr, data, byteEnable, which is
+ * empty if all bytes are enabled) and the combine buffers (valid, line,
+ * data, byteEnable) on an access. Posted writes are older than the lines
+ * still being combined, so the lines are applied last. posted_in_flight
+ * only lets the slots be skipped: lines are combined whether or not a
+ * posted write is in flight.
+ */
+template <typename PostedSlots, typename CombineBuffers>
+void
+overlayPendingWrites(uint64_t access_addr, uint8_t* access_data,
+                     unsigned access_size, bool read,
+                     PostedSlots& posted, unsigned posted_in_flight,
+                     CombineBuffers& combine, unsigned line_bytes)
+{
+    if (posted_in_flight != 0) {
+        for (auto& slot : posted) {
+            if (slot.busy) {
+                overlayPendingWrite(access_addr, access_data, access_size,
+                    read, slot.addr, slot.data.data(),
+                    slot.byteEnable.empty() ? nullptr
+                                            : slot.byteEnable.data(),
+                    slot.data.size());
+            }
+        }
+    }
+    for (auto& buffer : combine) {
+        if (buffer.valid) {
+            overlayPendingWrite(access_addr, access_data, access_size, read,
+                                buffer.line, buffer.data.data(),
+                                buffer.byteEnable.data(), line_bytes);
+        }
+    }
+}
+
+} // namespace Gem5SystemC
+
+#endif
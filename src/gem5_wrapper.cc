@@ -1,6 +1,11 @@
 #include "gem5_wrapper.hh"
 #include "assert.h"
 
+#include <iostream>
+
+#include "base/loader/object_file.hh"
+#include "sim/system.hh"
+
 namespace Gem5SystemC
 {
     Gem5Wrapper* Gem5Wrapper::instance = nullptr;
@@ -55,28 +60,43 @@ namespace Gem5SystemC
     TxnRouter* Gem5Wrapper::createTxnRouter(uint32_t id, sc_core::sc_module_name name,
                             uint64_t mem_start_addr,
                             uint64_t mem_size,
-                            bool debug)
+                            bool debug,
+                            const TxnRouterConfig& config)
     {
         TxnRouter* txn_router = new TxnRouter(name, mem_start_addr, 
-                                    mem_size,debug);
+                                    mem_size, debug, config);
         txn_routers.insert(std::make_pair(id, txn_router));
         return txn_router;
     }
 
-    SimpleBus<2,1>* Gem5Wrapper::
-    createSimpleBus(uint64_t mem_start_addr, uint64_t mem_end_addr)
+    SimpleBus* Gem5Wrapper::
+    createSimpleBus(uint64_t mem_start_addr, uint64_t mem_end_addr,
+                    unsigned nr_of_initiators, unsigned nr_of_targets,
+                    const SimpleBusConfig& config)
     {
         if (isBusCreated == true && busInstance != nullptr){
             return busInstance;
         }else{
-            auto bus = new SimpleBus<2,1>("simplebus");
-            bus->ports[0] = new PortMapping(mem_start_addr, mem_end_addr);
+            auto bus = new SimpleBus("simplebus", nr_of_initiators,
+                                     nr_of_targets, config);
+            bus->map_target(0, mem_start_addr, mem_end_addr);
             busInstance = bus;
             isBusCreated  = true;
             return bus;
         }
     }
 
+    SparseMemory* Gem5Wrapper::
+    createMemory(uint64_t mem_start_addr, uint64_t mem_size,
+                 const SparseMemoryConfig& config)
+    {
+        if (memInstance == nullptr){
+            memInstance = new SparseMemory("memory", mem_start_addr,
+                                           mem_size, config);
+        }
+        return memInstance;
+    }
+
     void Gem5Wrapper::bindSimControl2Transactor()
     {
         if (this->sim_control == nullptr){
@@ -115,9 +135,74 @@ namespace Gem5SystemC
         }   
     }
     
-    void Gem5Wrapper::bindBus2Memory()
+    void Gem5Wrapper::bindBus2Memory(uint32_t socket_id)
     {
-        
+        assert(busInstance != nullptr);
+        assert(memInstance != nullptr);
+        assert(socket_id < busInstance->isocks.size());
+        busInstance->isocks[socket_id].bind(memInstance->tsock);
+    }
+
+    bool Gem5Wrapper::saveMemorySnapshot(const std::string& path)
+    {
+        assert(memInstance != nullptr);
+        return memInstance->save_snapshot(path);
+    }
+
+    bool Gem5Wrapper::restoreMemorySnapshot(const std::string& path)
+    {
+        assert(memInstance != nullptr);
+        return memInstance->restore_snapshot(path);
+    }
+
+    bool Gem5Wrapper::preloadImage(const std::string& path, uint64_t offset)
+    {
+        return preload(path, false, offset);
+    }
+
+    bool Gem5Wrapper::preloadRawImage(const std::string& path, uint64_t base)
+    {
+        return preload(path, true, base);
+    }
+
+    bool Gem5Wrapper::preload(const std::string& path, bool raw,
+                              uint64_t offset)
+    {
+        gem5::loader::ObjectFile* object =
+            gem5::loader::createObjectFile(path, raw);
+        if (object == nullptr) {
+            std::cerr << "Cannot read image " << path << std::endl;
+            return false;
+        }
+        gem5::loader::MemoryImage image = object->buildImage();
+        image.offset(offset);
+        bool ok = true;
+        for (auto& segment : image.segments()) {
+            // .bss and alike come without data and are zeroed
+            bool zero = segment.data == nullptr;
+            // one copy into the pages instead of a transaction per line
+            if (memInstance != nullptr &&
+                (zero ? memInstance->fill(segment.base, 0, segment.size)
+                      : memInstance->load(segment.base, segment.data,
+                                          segment.size))) {
+                continue;
+            }
+            // not (entirely) in our memory, let gem5 find the target
+            if (gem5::System::systemList.empty()) {
+                std::cerr << "No gem5 system to load " << segment.name
+                          << " of " << path << std::endl;
+                ok = false;
+                break;
+            }
+            auto& proxy = gem5::System::systemList[0]->physProxy;
+            if (zero) {
+                proxy.memsetBlob(segment.base, 0, segment.size);
+            } else {
+                proxy.writeBlob(segment.base, segment.data, segment.size);
+            }
+        }
+        delete object;
+        return ok;
     }
 }
 
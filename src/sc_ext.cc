@@ -41,6 +41,7 @@ namespace Gem5SystemC
 Gem5Extension::Gem5Extension(gem5::PacketPtr packet)
 {
     Packet = packet;
+    coreId = 0;
 }
 
 Gem5Extension& Gem5Extension::getExtension(const tlm_generic_payload *payload)
@@ -63,13 +64,20 @@ gem5::PacketPtr Gem5Extension::getPacket()
 
 tlm_extension_base* Gem5Extension::clone() const
 {
-    return new Gem5Extension(Packet);
+    auto ext = new Gem5Extension(Packet);
+    ext->coreId = coreId;
+    ext->postedSlot = postedSlot;
+    ext->timestamps = timestamps;
+    return ext;
 }
 
 void Gem5Extension::copy_from(const tlm_extension_base& ext)
 {
     const Gem5Extension& cpyFrom = static_cast<const Gem5Extension&>(ext);
     Packet = cpyFrom.Packet;
+    coreId = cpyFrom.coreId;
+    postedSlot = cpyFrom.postedSlot;
+    timestamps = cpyFrom.timestamps;
 }
 
 }
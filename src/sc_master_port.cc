@@ -32,6 +32,7 @@
 
 #include <sstream>
 
+#include "host_time.h"
 #include "master_transactor.hh"
 #include "params/ExternalMaster.hh"
 #include "sc_ext.hh"
@@ -90,6 +91,9 @@ SCMasterPort::SCMasterPort(const std::string& name_,
     pendingPacket(nullptr),
     needToSendRetry(false),
     responseInProgress(false),
+    responseStart(0),
+    tracePid(0),
+    transactions(0),
     transactor(nullptr),
     simControl(simControl)
 {
@@ -143,6 +147,7 @@ tlm::tlm_sync_enum
 SCMasterPort::nb_transport_fw(tlm::tlm_generic_payload& trans,
                               tlm::tlm_phase& phase, sc_core::sc_time& delay)
 {
+    HostTimeScope host_time(HOST_TIME_MASTER_PORT);
     uint64_t adr = trans.get_address();
     unsigned len = trans.get_data_length();
     unsigned char* byteEnable = trans.get_byte_enable_ptr();
@@ -168,6 +173,7 @@ void
 SCMasterPort::peq_cb(tlm::tlm_generic_payload& trans,
                        const tlm::tlm_phase& phase)
 {
+    HostTimeScope host_time(HOST_TIME_MASTER_PORT);
     // catch up with SystemC time
     simControl.catchup();
     assert(gem5::curTick() == sc_core::sc_time_stamp().value());
@@ -195,6 +201,7 @@ SCMasterPort::handleBeginReq(tlm::tlm_generic_payload& trans)
     sc_assert(pendingRequest == nullptr);
     sc_assert(pendingPacket == nullptr);
 
+    transactions++;
     trans.acquire();
 
     gem5::PacketPtr pkt = nullptr;
@@ -215,6 +222,7 @@ SCMasterPort::handleBeginReq(tlm::tlm_generic_payload& trans)
     pkt->pushSenderState(tlmSenderState);
 
     if (sendTimingReq(pkt)) { // port is free -> send END_REQ immediately
+        tlmSenderState->endReq = gem5::curTick();
         sendEndReq(trans);
         trans.release();
     } else { // port is blocked -> wait for retry before sending END_REQ
@@ -230,6 +238,7 @@ SCMasterPort::handleEndResp(tlm::tlm_generic_payload& trans)
     sc_assert(responseInProgress);
 
     responseInProgress = false;
+    traceResponse(trans);
 
     checkTransaction(trans);
 
@@ -254,6 +263,8 @@ void
 SCMasterPort::b_transport(tlm::tlm_generic_payload& trans,
                         sc_core::sc_time& t)
 {
+    HostTimeScope host_time(HOST_TIME_MASTER_PORT);
+    transactions++;
     Gem5Extension* extension = nullptr;
     trans.get_extension(extension);
 
@@ -289,6 +300,7 @@ SCMasterPort::b_transport(tlm::tlm_generic_payload& trans,
 unsigned int
 SCMasterPort::transport_dbg(tlm::tlm_generic_payload& trans)
 {
+    HostTimeScope host_time(HOST_TIME_MASTER_PORT);
     Gem5Extension* extension = nullptr;
     trans.get_extension(extension);
 
@@ -315,6 +327,7 @@ SCMasterPort::get_direct_mem_ptr(tlm::tlm_generic_payload& trans,
 bool
 SCMasterPort::recvTimingResp(gem5::PacketPtr pkt)
 {
+    HostTimeScope host_time(HOST_TIME_MASTER_PORT);
     // exclusion rule
     // We need to Wait for END_RESP before sending next BEGIN_RESP
     if (responseInProgress) {
@@ -343,6 +356,16 @@ SCMasterPort::recvTimingResp(gem5::PacketPtr pkt)
     Gem5Extension* extension = nullptr;
     trans.get_extension(extension);
 
+    if (auto trace = ChromeTrace::get()) {
+        uint64_t tick_ps = gem5::sim_clock::as_int::ps;
+        trace->span(getTracePid(*trace), 0, "request",
+                    tlmSenderState->beginReq / tick_ps,
+                    tlmSenderState->endReq / tick_ps, trans.get_address());
+        trace->asyncSpan(getTracePid(*trace), 0, "service",
+                         tlmSenderState->endReq / tick_ps,
+                         gem5::curTick() / tick_ps, trans.get_address());
+    }
+
     // clean up
     delete tlmSenderState;
 
@@ -364,6 +387,7 @@ SCMasterPort::sendBeginResp(tlm::tlm_generic_payload& trans,
     tlm::tlm_phase phase = tlm::BEGIN_RESP;
 
     trans.set_response_status(tlm::TLM_OK_RESPONSE);
+    responseStart = gem5::curTick();
 
     auto status = transactor->socket->nb_transport_bw(trans, phase, delay);
 
@@ -371,6 +395,7 @@ SCMasterPort::sendBeginResp(tlm::tlm_generic_payload& trans,
         status == tlm::TLM_UPDATED && phase == tlm::END_RESP) {
         // transaction completed -> no need to wait for tlm::END_RESP
         responseInProgress = false;
+        traceResponse(trans);
     } else if (status == tlm::TLM_ACCEPTED) {
         // we need to wait for tlm::END_RESP
         responseInProgress = true;
@@ -382,11 +407,17 @@ SCMasterPort::sendBeginResp(tlm::tlm_generic_payload& trans,
 void
 SCMasterPort::recvReqRetry()
 {
+    HostTimeScope host_time(HOST_TIME_MASTER_PORT);
     sc_assert(waitForRetry);
     sc_assert(pendingRequest != nullptr);
     sc_assert(pendingPacket != nullptr);
 
+    // ours until the packet is taken
+    auto tlmSenderState =
+        dynamic_cast<TlmSenderState*>(pendingPacket->senderState);
+
     if (sendTimingReq(pendingPacket)) {
+        tlmSenderState->endReq = gem5::curTick();
         waitForRetry = false;
         pendingPacket = nullptr;
 
@@ -398,6 +429,28 @@ SCMasterPort::recvReqRetry()
     }
 }
 
+uint32_t
+SCMasterPort::getTracePid(ChromeTrace& trace)
+{
+    if (tracePid == 0) {
+        tracePid = trace.addProcess(name());
+        trace.nameTrack(tracePid, 0, "request");
+        trace.nameTrack(tracePid, 1, "response");
+    }
+    return tracePid;
+}
+
+void
+SCMasterPort::traceResponse(tlm::tlm_generic_payload& trans)
+{
+    if (auto trace = ChromeTrace::get()) {
+        trace->span(getTracePid(*trace), 1, "response",
+                    responseStart / gem5::sim_clock::as_int::ps,
+                    gem5::curTick() / gem5::sim_clock::as_int::ps,
+                    trans.get_address());
+    }
+}
+
 void
 SCMasterPort::recvRangeChange()
 {
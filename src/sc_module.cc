@@ -57,7 +57,9 @@
 #include "base/logging.hh"
 #include "base/pollevent.hh"
 #include "base/trace.hh"
+#include "chrome_trace.h"
 #include "debug/Event.hh"
+#include "host_time.h"
 #include "sc_module.hh"
 #include "sim/async.hh"
 #include "sim/core.hh"
@@ -190,10 +192,27 @@ Module::serviceExternalEvent()
         eventLoop();
 }
 
+/** Record an activation of the event loop in the ChromeTrace */
+static void
+traceActivation(uint64_t serviced)
+{
+    static uint32_t pid = 0;
+    ChromeTrace *trace = ChromeTrace::get();
+    if (!trace || serviced == 0)
+        return;
+    if (pid == 0) {
+        pid = trace->addProcess("gem5");
+        trace->nameTrack(pid, 0, "event loop");
+    }
+    trace->instant(pid, 0, "eventLoop",
+        gem5::curTick() / gem5::sim_clock::as_int::ps, serviced);
+}
+
 void
 Module::eventLoop()
 {
     gem5::EventQueue *eventq = gem5::getEventQueue(0);
+    uint64_t serviced = 0;
 
     fatal_if(!in_simulate, "Gem5SystemC event loop entered while"
         " outside Gem5SystemC::Module::simulate");
@@ -227,6 +246,7 @@ Module::eventLoop()
             eventLoopEnterEvent.notify(sc_core::sc_time::from_value(
                 sc_dt::uint64(wait_period)));
 
+            traceActivation(serviced);
             return;
         } else if (gem5_time > next_event_time) {
             gem5::Tick systemc_time = sc_core::sc_time_stamp().value();
@@ -237,10 +257,15 @@ Module::eventLoop()
                 next_event_time, gem5_time, systemc_time);
         } else {
             /* Service an event */
-            exitEvent = eventq->serviceOne();
+            {
+                HostTimeScope host_time(HOST_TIME_GEM5_EVENTS);
+                exitEvent = eventq->serviceOne();
+            }
+            serviced++;
 
             if (exitEvent) {
                 eventLoopExitEvent.notify(sc_core::SC_ZERO_TIME);
+                traceActivation(serviced);
                 return;
             }
         }
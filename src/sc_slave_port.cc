@@ -31,11 +31,18 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <algorithm>
+#include <cstring>
+
+#include "amo_ext.h"
 #include "blocking_packet_helper.hh"
+#include "host_time.h"
 #include "sc_ext.hh"
 #include "sc_mm.hh"
 #include "sc_slave_port.hh"
 #include "slave_transactor.hh"
+#include "snoop_filter.h"
+#include "write_overlay.h"
 // This head file is used to set chiattr in Neutra Pkt
 // #include "common/chi-utils.h" 
 
@@ -48,16 +55,59 @@ namespace Gem5SystemC
  */
 MemoryManager mm;
 
+/**
+ * Atomic operations (swaps, AMOs) and LR/SC are sent as one transaction
+ * with an AmoExtension, which the target executes atomically. The
+ * extension is allocated unless the caller provides one.
+ */
+void
+packet2amo(gem5::PacketPtr packet, tlm::tlm_generic_payload &trans,
+           AmoExtension *amo)
+{
+    if (amo != nullptr) {
+        *amo = AmoExtension();
+    } else {
+        amo = new AmoExtension;
+    }
+    if (packet->isLLSC()) {
+        amo->op = packet->isWrite() ? AMO_STORE_CONDITIONAL
+                                    : AMO_LOAD_RESERVED;
+        amo->reservation_id = packet->req->hasContextId()
+            ? packet->req->contextId() : packet->requestorId();
+    } else if (packet->isAtomicOp()) {
+        /* The functor hides the opcode, let the target apply it */
+        gem5::AtomicOpFunctor *op = packet->getAtomicOp();
+        amo->op = AMO_FUNCTOR;
+        amo->functor = [op](uint8_t *mem) { (*op)(mem); };
+    } else {
+        if (packet->getSize() > sizeof(amo->operand)) {
+            SC_REPORT_FATAL("SCSlavePort", "Swap wider than 8 bytes");
+        }
+        amo->op = packet->req->isCondSwap() ? AMO_CAS : AMO_SWAP;
+        std::memcpy(&amo->operand, packet->getConstPtr<uint8_t>(),
+                    packet->getSize());
+        amo->compare = packet->req->getExtraData();
+    }
+    trans.set_command(amo->op == AMO_STORE_CONDITIONAL ?
+                      tlm::TLM_WRITE_COMMAND : tlm::TLM_READ_COMMAND);
+    if (trans.has_mm()) {
+        trans.set_auto_extension(amo);
+    } else {
+        trans.set_extension(amo);
+    }
+}
+
 /**
  * Convert a gem5 packet to a TLM payload by copying all the relevant
- * information to a previously allocated tlm payload
+ * information to a previously allocated tlm payload. A payload without mm
+ * (the port's synchronous payload) needs the AmoExtension to use.
  */
 void
-packet2payload(gem5::PacketPtr packet, tlm::tlm_generic_payload &trans)
+packet2payload(gem5::PacketPtr packet, tlm::tlm_generic_payload &trans,
+               AmoExtension *amo = nullptr)
 {
     trans.set_address(packet->getAddr());
-    /* Check if this transaction was allocated by mm */
-    sc_assert(trans.has_mm());
+    sc_assert(trans.has_mm() || amo != nullptr);
 
     uint32_t size = packet->getSize();
     unsigned char *data = packet->getPtr<unsigned char>();
@@ -65,12 +115,20 @@ packet2payload(gem5::PacketPtr packet, tlm::tlm_generic_payload &trans)
     trans.set_data_length(size);
     trans.set_streaming_width(size);
     trans.set_data_ptr(data);
-
-    if (packet->isRead()) {
+    /* A recycled payload may still carry combined-write byte enables */
+    trans.set_byte_enable_ptr(nullptr);
+    trans.set_byte_enable_length(0);
+    trans.set_response_status(tlm::TLM_INCOMPLETE_RESPONSE);
+
+    if (packet->isAtomicOp() || packet->isLLSC() ||
+        packet->cmd == gem5::MemCmd::SwapReq) {
+        packet2amo(packet, trans, trans.has_mm() ? nullptr : amo);
+    } else if (packet->isRead()) {
         trans.set_command(tlm::TLM_READ_COMMAND);
     }
     else if (packet->isInvalidate()) {
-        /* Do nothing */
+        /* Nothing to transfer, don't leave a recycled command behind */
+        trans.set_command(tlm::TLM_IGNORE_COMMAND);
     } else if (packet->isWrite()) {
         trans.set_command(tlm::TLM_WRITE_COMMAND);
     } else {
@@ -78,12 +136,33 @@ packet2payload(gem5::PacketPtr packet, tlm::tlm_generic_payload &trans)
     }
 }
 
+/**
+ * Make sure the target executed an atomic operation instead of a plain
+ * read or write, and return the outcome of a store conditional to gem5
+ */
+void
+finishAmo(tlm::tlm_generic_payload &trans, gem5::PacketPtr packet)
+{
+    auto amo = trans.get_extension<AmoExtension>();
+    if (!amo) {
+        return;
+    }
+    if (!amo->executed) {
+        SC_REPORT_FATAL("SCSlavePort",
+                        "Atomic operation not supported by the target");
+    }
+    if (amo->op == AMO_STORE_CONDITIONAL) {
+        packet->req->setExtraData(amo->sc_success ? 1 : 0);
+    }
+}
+
 /**
  * Similar to TLM's blocking transport (LT)
  */
 gem5::Tick
 SCSlavePort::recvAtomic(gem5::PacketPtr packet)
 {
+    HostTimeScope host_time(HOST_TIME_SLAVE_PORT);
     CAUGHT_UP;
     SC_REPORT_INFO("SCSlavePort", "recvAtomic hasn't been tested much");
 
@@ -96,20 +175,15 @@ SCSlavePort::recvAtomic(gem5::PacketPtr packet)
     sc_core::sc_time delay = sc_core::SC_ZERO_TIME;
 
     /* Prepare the transaction */
-    tlm::tlm_generic_payload * trans = mm.allocate();
-    trans->acquire();
-    packet2payload(packet, *trans);
+    uint32_t socket_id = this->getSocketId(packet);
+    acceptRequest(packet, socket_id);
+    tlm::tlm_generic_payload * trans = getSyncPayload(packet, socket_id);
 
-    /* Attach the packet pointer to the TLM transaction to keep track */
-    Gem5Extension* extension = new Gem5Extension(packet);
-    uint32_t socket_id = this->getSocketId(packet->requestorId());
-    extension->setCoreID(socket_id);
-    trans->set_auto_extension(extension);
+    /* Agents write back and give up the lines first */
+    delay = snoopAgents(packet, false);
 
     /* Execute b_transport: */
-    if (packet->cmd == gem5::MemCmd::SwapReq) {
-        SC_REPORT_FATAL("SCSlavePort", "SwapReq not supported");
-    } else if (packet->isRead()) {
+    if (packet->isRead()) {
         if (transactor != nullptr) {
             transactor->socket->b_transport(*trans, delay);
         } else if (transactor_multi != nullptr) {
@@ -141,12 +215,13 @@ SCSlavePort::recvAtomic(gem5::PacketPtr packet)
     } else {
         SC_REPORT_FATAL("SCSlavePort", "Typo of request not supported");
     }
+    finishAmo(*trans, packet);
 
     if (packet->needsResponse()) {
         packet->makeResponse();
     }
 
-    trans->release();
+    putSyncPayload(trans);
 
     return delay.value();
 }
@@ -157,16 +232,10 @@ SCSlavePort::recvAtomic(gem5::PacketPtr packet)
 void
 SCSlavePort::recvFunctional(gem5::PacketPtr packet)
 {
+    HostTimeScope host_time(HOST_TIME_SLAVE_PORT);
     /* Prepare the transaction */
-    tlm::tlm_generic_payload * trans = mm.allocate();
-    trans->acquire();
-    packet2payload(packet, *trans);
-
-    /* Attach the packet pointer to the TLM transaction to keep track */
-    Gem5Extension* extension = new Gem5Extension(packet);
-    uint32_t socket_id = this->getSocketId(packet->requestorId());
-    extension->setCoreID(socket_id);
-    trans->set_auto_extension(extension);
+    uint32_t socket_id = this->getSocketId(packet);
+    tlm::tlm_generic_payload * trans = getSyncPayload(packet, socket_id);
 
     /* Execute Debug Transport: */
     uint32_t bytes;
@@ -180,23 +249,110 @@ SCSlavePort::recvFunctional(gem5::PacketPtr packet)
     if (bytes != trans->get_data_length()) {
         SC_REPORT_FATAL("SCSlavePort","debug transport was not completed");
     }
+    functionalPostedWrites(packet);
+    snoopAgents(packet, true);
 
-    trans->release();
+    putSyncPayload(trans);
+}
+
+tlm::tlm_generic_payload *
+SCSlavePort::getSyncPayload(gem5::PacketPtr packet, uint32_t socket_id)
+{
+    if (syncPayloadBusy) {
+        /* Re-entered from downstream, fall back to a payload of mm */
+        tlm::tlm_generic_payload * trans = mm.allocate();
+        trans->acquire();
+        packet2payload(packet, *trans);
+        Gem5Extension* extension = new Gem5Extension(packet);
+        extension->setCoreID(socket_id);
+        trans->set_auto_extension(extension);
+        return trans;
+    }
+    syncPayloadBusy = true;
+    packet2payload(packet, syncPayload, &syncAmo);
+    syncPayload.set_dmi_allowed(false);
+    syncExtension.setPacket(packet);
+    syncExtension.setCoreID(socket_id);
+    syncPayload.set_extension(&syncExtension);
+    return &syncPayload;
+}
+
+void
+SCSlavePort::putSyncPayload(tlm::tlm_generic_payload *trans)
+{
+    if (trans != &syncPayload) {
+        trans->release();
+        return;
+    }
+    /* The extensions are members, only detach them */
+    syncPayload.clear_extension(&syncExtension);
+    syncPayload.clear_extension(&syncAmo);
+    syncPayloadBusy = false;
 }
 
 bool
 SCSlavePort::recvTimingSnoopResp(gem5::PacketPtr packet)
 {
-    /* Snooping should be implemented with tlm_dbg_transport */
-    SC_REPORT_FATAL("SCSlavePort","unimplemented func.: recvTimingSnoopResp");
+    /* SystemC agents are snooped through the transactor's snoop sockets,
+     * the port never sends snoop requests to gem5 */
+    SC_REPORT_FATAL("SCSlavePort","unexpected snoop response");
     return false;
 }
 
 void
 SCSlavePort::recvFunctionalSnoop(gem5::PacketPtr packet)
 {
-    /* Snooping should be implemented with tlm_dbg_transport */
-    SC_REPORT_FATAL("SCSlavePort","unimplemented func.: recvFunctionalSnoop");
+    HostTimeScope host_time(HOST_TIME_SLAVE_PORT);
+    /* Only SystemC agents can hold the data, memory is not involved */
+    snoopAgents(packet, true);
+}
+
+sc_core::sc_time
+SCSlavePort::snoopAgents(gem5::PacketPtr packet, bool functional)
+{
+    sc_core::sc_time delay = sc_core::SC_ZERO_TIME;
+    if (transactor_multi == nullptr || !transactor_multi->isSnooping()) {
+        return delay;
+    }
+    SnoopFilter& filter = transactor_multi->snoopFilter;
+    uint32_t holders = filter.holders(packet->getAddr(), packet->getSize());
+    if (holders == 0) {
+        return delay;
+    }
+
+    tlm::tlm_generic_payload *trans = mm.allocate();
+    trans->acquire();
+    trans->set_address(packet->getAddr());
+    trans->set_data_length(packet->getSize());
+    trans->set_streaming_width(packet->getSize());
+    trans->set_byte_enable_ptr(nullptr);
+    trans->set_byte_enable_length(0);
+    auto snoop = new SnoopExtension;
+    snoop->invalidate = packet->isWrite() || packet->needsWritable();
+    trans->set_auto_extension(snoop);
+
+    for (uint32_t agent = 0; holders != 0; agent++, holders >>= 1) {
+        if ((holders & 1) == 0) {
+            continue;
+        }
+        auto& socket = transactor_multi->snoop_sockets[agent];
+        trans->set_response_status(tlm::TLM_INCOMPLETE_RESPONSE);
+        if (functional) {
+            trans->set_command(packet->isRead() ? tlm::TLM_READ_COMMAND
+                                                : tlm::TLM_WRITE_COMMAND);
+            trans->set_data_ptr(packet->getPtr<unsigned char>());
+            socket->transport_dbg(*trans);
+        } else {
+            trans->set_command(tlm::TLM_IGNORE_COMMAND);
+            trans->set_data_ptr(nullptr);
+            socket->b_transport(*trans, delay);
+            if (snoop->invalidate) {
+                filter.remove(packet->getAddr(), packet->getSize(), agent);
+            }
+        }
+    }
+    trans->release();
+    return delay;
 }
 
 /**
@@ -205,6 +361,7 @@ SCSlavePort::recvFunctionalSnoop(gem5::PacketPtr packet)
 bool
 SCSlavePort::recvTimingReq(gem5::PacketPtr packet)
 {
+    HostTimeScope host_time(HOST_TIME_SLAVE_PORT);
     CAUGHT_UP;
     panic_if(packet->cacheResponding(), "Should not see packets where cache "
              "is responding");
@@ -212,17 +369,38 @@ SCSlavePort::recvTimingReq(gem5::PacketPtr packet)
     panic_if(!(packet->isRead() || packet->isWrite()),
              "Should only see read and writes at TLM memory\n");
 
+    if (!fetchBypassRequestors.empty() && packet->isRead() &&
+        !packet->isWrite() &&
+        fetchBypassRequestors.count(packet->requestorId())) {
+        if (!fetchBypass(packet)) {
+            return false;
+        }
+        acceptRequest(packet, capture ? getSocketId(packet) : 0);
+        return true;
+    }
+
     /* We should never get a second request after noting that a retry is
      * required */
     sc_assert(!needToSendRequestRetry);
     // get target socket id
-    uint32_t socket_id = this->getSocketId(packet->requestorId()); 
+    uint32_t socket_id = this->getSocketId(packet);
 
-    if (packet->hasCpuClusterId()) {
+    if (packet->hasCpuClusterId() &&
+        !(transactor_multi && transactor_multi->isInterleaving())) {
         if (packet->cpuClusterId() != socket_id){
             socket_id = packet->cpuClusterId();
         }
     }
+
+    if (!combineBuffers.empty()) {
+        CombineResult result = combineWrite(packet, socket_id);
+        if (result != COMBINE_PASS) {
+            if (result == COMBINE_MERGED) {
+                acceptRequest(packet, socket_id);
+            }
+            return result == COMBINE_MERGED;
+        }
+    }
     
     /* Remember if a request comes in while we're blocked so that a retry
      * can be sent to gem5 */
@@ -238,6 +416,18 @@ SCSlavePort::recvTimingReq(gem5::PacketPtr packet)
         return false;
     }
 
+    /* A full posted-write buffer stalls further posted writes. Accesses
+     * overlapping a posted write wait for it, so they cannot overtake it on
+     * another socket or path through SystemC */
+    bool posted = canPost(packet);
+    if (!postedWrites.empty() &&
+        ((posted && postedInFlight == postedWrites.size()) ||
+         postedHazard(packet->getAddr(),
+                      packet->getAddr() + packet->getSize()))) {
+        postedRetryPending = true;
+        return false;
+    }
+
     /*  NOTE: normal tlm is blocking here. But in our case we return false
      *  and tell gem5 when a retry can be done. This is the main difference
      *  in the protocol:
@@ -257,8 +447,18 @@ SCSlavePort::recvTimingReq(gem5::PacketPtr packet)
     Gem5Extension* extension = new Gem5Extension(packet);
 
     extension->setCoreID(socket_id);
+    extension->timestamps.request = gem5::curTick();
     trans->set_auto_extension(extension);
 
+    if (posted) {
+        /* Write from a copy, the packet goes back to gem5 at END_REQ */
+        int slot = allocPostedWrite(packet->getAddr(),
+                                    packet->getConstPtr<uint8_t>(),
+                                    packet->getSize());
+        trans->set_data_ptr(postedWrites[slot].data.data());
+        extension->setPostedSlot(slot);
+    }
+
     if (trans->is_write()){
         /*
           For Neutra work, set up chi attr and opcode
@@ -297,6 +497,44 @@ SCSlavePort::recvTimingReq(gem5::PacketPtr packet)
     packet->payloadDelay = 0;
     packet->headerDelay = 0;
 
+    delay += snoopAgents(packet, false);
+    acceptRequest(packet, socket_id);
+    sendBeginReq(trans, socket_id, delay);
+    return true;
+}
+
+void
+SCSlavePort::acceptRequest(gem5::PacketPtr packet, uint32_t socket_id)
+{
+    transactions++;
+    if (!capture) {
+        return;
+    }
+    ReqTraceCommand command = REQ_TRACE_OTHER;
+    if (packet->isRead() && packet->isWrite()) {
+        command = REQ_TRACE_ATOMIC;
+    } else if (packet->isRead()) {
+        command = REQ_TRACE_READ;
+    } else if (packet->isWrite()) {
+        command = REQ_TRACE_WRITE;
+    }
+    capture->record({gem5::curTick(), packet->getAddr(), socket_id,
+                     packet->requestorId(), packet->getSize(), command});
+}
+
+void
+SCSlavePort::closeCapture()
+{
+    if (capture && !capture->close()) {
+        SC_REPORT_WARNING("SCSlavePort", "Writing the request capture failed");
+    }
+    capture.reset();
+}
+
+void
+SCSlavePort::sendBeginReq(tlm::tlm_generic_payload* trans, uint32_t socket_id,
+                          sc_core::sc_time delay)
+{
     /* Starting TLM non-blocking sequence (AT) Refer to IEEE1666-2011 SystemC
      * Standard Page 507 for a visualisation of the procedure */
     tlm::tlm_phase phase = tlm::BEGIN_REQ;
@@ -330,18 +568,522 @@ SCSlavePort::recvTimingReq(gem5::PacketPtr packet)
     } else if (status == tlm::TLM_COMPLETED) {
         /* Transaction is over nothing has do be done. */
         sc_assert(phase == tlm::END_RESP);
-        trans->release();
+        if (Gem5Extension::getExtension(trans).isPosted()) {
+            /* gem5 still waits for the response of a posted write */
+            PayloadEvent<SCSlavePort> * pe;
+            pe = new PayloadEvent<SCSlavePort>(*this,
+                &SCSlavePort::pec, "PEQ");
+            pe->notify(*trans, phase, delay);
+        } else {
+            trans->release();
+        }
+    }
+}
+
+void
+SCSlavePort::sendEndResp(tlm::tlm_generic_payload& trans, uint32_t socket_id)
+{
+    tlm::tlm_phase phase = tlm::END_RESP;
+    sc_core::sc_time delay = sc_core::SC_ZERO_TIME;
+    if (transactor != nullptr) {
+        transactor->socket->nb_transport_fw(trans, phase, delay);
+    } else if (transactor_multi != nullptr) {
+        transactor_multi->sockets[socket_id]->nb_transport_fw(trans,
+                                                              phase, delay);
+    } else {
+        SC_REPORT_FATAL("SCSlavePort", "No binded transactor, please check");
+    }
+}
+
+bool
+SCSlavePort::canPost(gem5::PacketPtr packet)
+{
+    return !postedWrites.empty() && packet->isWrite() && !packet->isRead() &&
+        packet->hasData() && !packet->isLLSC() && !packet->isAtomicOp() &&
+        !packet->isMaskedWrite();
+}
+
+bool
+SCSlavePort::postedHazard(gem5::Addr start, gem5::Addr end)
+{
+    if (postedInFlight == 0) {
+        return false;
+    }
+    for (auto& slot : postedWrites) {
+        if (slot.busy && start < slot.addr + slot.data.size() &&
+            slot.addr < end) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int
+SCSlavePort::allocPostedWrite(gem5::Addr addr, const uint8_t *data,
+                              unsigned size, const uint8_t *byte_enable)
+{
+    for (size_t i = 0; i < postedWrites.size(); i++) {
+        auto& slot = postedWrites[i];
+        if (!slot.busy) {
+            slot.data.assign(data, data + size);
+            if (byte_enable) {
+                slot.byteEnable.assign(byte_enable, byte_enable + size);
+            } else {
+                slot.byteEnable.clear();
+            }
+            slot.addr = addr;
+            slot.busy = true;
+            postedInFlight++;
+            return i;
+        }
+    }
+    panic("No free posted-write slot");
+}
+
+void
+SCSlavePort::respondPosted(tlm::tlm_generic_payload& trans)
+{
+    auto& extension = Gem5Extension::getExtension(trans);
+    auto packet = extension.getPacket();
+    if (packet == nullptr) {
+        /* gem5 has its response already */
+        return;
+    }
+    extension.setPacket(nullptr);
+    respondEarly(packet);
+}
+
+void
+SCSlavePort::respondEarly(gem5::PacketPtr packet)
+{
+    if (packet->needsResponse()) {
+        packet->makeResponse();
+        sendPostedResponse(packet);
+    } else {
+        /* The receiver owns packets that need no response */
+        delete packet;
+    }
+}
+
+void
+SCSlavePort::sendPostedResponse(gem5::PacketPtr packet)
+{
+    /* Keep the order of the early responses */
+    if (postedResponses.empty() && sendTimingResp(packet)) {
+        return;
+    }
+    postedResponses.push_back(packet);
+}
+
+void
+SCSlavePort::freePostedWrite(tlm::tlm_generic_payload& trans)
+{
+    auto& extension = Gem5Extension::getExtension(trans);
+    auto& slot = postedWrites[extension.getPostedSlot()];
+    sc_assert(slot.busy);
+    slot.busy = false;
+    postedInFlight--;
+    extension.setPostedSlot(-1);
+    if (postedRetryPending) {
+        postedRetryPending = false;
+        sendRetryReq();
+    }
+}
+
+void
+SCSlavePort::functionalPostedWrites(gem5::PacketPtr packet)
+{
+    if (!packet->isRead() && !packet->isWrite()) {
+        return;
+    }
+    overlayPendingWrites(packet->getAddr(), packet->getPtr<uint8_t>(),
+                         packet->getSize(), packet->isRead(),
+                         postedWrites, postedInFlight,
+                         combineBuffers, combineLineBytes);
+}
+
+SCSlavePort::CombineResult
+SCSlavePort::combineWrite(gem5::PacketPtr packet, uint32_t socket_id)
+{
+    const gem5::RequestPtr &req = packet->req;
+    bool barrier = req->isUncacheable() || req->isStrictlyOrdered() ||
+        req->isAcquire() || req->isRelease() || packet->isFlush();
+    gem5::Addr start = packet->getAddr();
+    gem5::Addr end = start + packet->getSize();
+    gem5::Addr line = start & ~gem5::Addr(combineLineBytes - 1);
+    bool mergeable = !barrier && canPost(packet) &&
+        end <= line + combineLineBytes;
+
+    /* Issue the lines the packet must not overtake and the line of its
+     * socket if the packet goes to another one */
+    for (uint32_t s = 0; s < combineBuffers.size(); s++) {
+        auto& buffer = combineBuffers[s];
+        if (!buffer.valid) {
+            continue;
+        }
+        bool flush;
+        if (barrier) {
+            flush = true;
+        } else if (mergeable && s == socket_id) {
+            flush = buffer.line != line;
+        } else {
+            flush = start < buffer.line + combineLineBytes &&
+                buffer.line < end;
+        }
+        if (flush && !flushCombine(s, true)) {
+            return COMBINE_RETRY;
+        }
+    }
+    if (!mergeable) {
+        return COMBINE_PASS;
+    }
+
+    /* The response is early, the snoop delay is hidden */
+    snoopAgents(packet, false);
+
+    auto& buffer = combineBuffers[socket_id];
+    if (!buffer.valid) {
+        buffer.valid = true;
+        buffer.line = line;
+        std::fill(buffer.byteEnable.begin(), buffer.byteEnable.end(),
+                  tlm::TLM_BYTE_DISABLED);
+        scheduleEvent(*buffer.timeout, gem5::curTick() + combineWindow);
+    }
+    std::memcpy(buffer.data.data() + (start - line),
+                packet->getConstPtr<uint8_t>(), packet->getSize());
+    std::fill_n(buffer.byteEnable.begin() + (start - line), packet->getSize(),
+                tlm::TLM_BYTE_ENABLED);
+
+    /* gem5 does not allow a response from within recvTimingReq */
+    packet->payloadDelay = 0;
+    packet->headerDelay = 0;
+    combinedPackets.push_back(packet);
+    if (!combineRespondEvent.scheduled()) {
+        scheduleEvent(combineRespondEvent, gem5::curTick());
+    }
+
+    if (std::find(buffer.byteEnable.begin(), buffer.byteEnable.end(),
+                  tlm::TLM_BYTE_DISABLED) == buffer.byteEnable.end()) {
+        /* Full line, no point in waiting. The timeout retries if this
+         * fails */
+        flushCombine(socket_id, false);
+    }
+    return COMBINE_MERGED;
+}
+
+bool
+SCSlavePort::flushCombine(uint32_t socket_id, bool retry)
+{
+    auto& buffer = combineBuffers[socket_id];
+    if (!buffer.valid) {
+        return true;
     }
+    if (blk_pkt_helper->isBlockedPort(socket_id, pktType::Request) ||
+        (socket_id == 0 && usingGem5Cache && blockingRequest)) {
+        if (retry) {
+            blk_pkt_helper->updateRetryMap(socket_id, true);
+        }
+        return false;
+    }
+
+    /* Issue the enabled extent of the line, byte enables only for holes */
+    const uint8_t *enable = buffer.byteEnable.data();
+    unsigned lo = 0;
+    unsigned hi = combineLineBytes;
+    while (enable[lo] == tlm::TLM_BYTE_DISABLED) {
+        lo++;
+    }
+    while (enable[hi - 1] == tlm::TLM_BYTE_DISABLED) {
+        hi--;
+    }
+    gem5::Addr start = buffer.line + lo;
+    if (postedInFlight == postedWrites.size() ||
+        postedHazard(start, buffer.line + hi)) {
+        if (retry) {
+            postedRetryPending = true;
+        }
+        return false;
+    }
+    bool holes = std::find(enable + lo, enable + hi,
+                           tlm::TLM_BYTE_DISABLED) != enable + hi;
+    int slot = allocPostedWrite(start, buffer.data.data() + lo, hi - lo,
+                                holes ? enable + lo : nullptr);
+    auto& posted = postedWrites[slot];
 
+    tlm::tlm_generic_payload *trans = mm.allocate();
+    trans->acquire();
+    trans->set_command(tlm::TLM_WRITE_COMMAND);
+    trans->set_address(start);
+    trans->set_data_ptr(posted.data.data());
+    trans->set_data_length(hi - lo);
+    trans->set_streaming_width(hi - lo);
+    trans->set_byte_enable_ptr(holes ? posted.byteEnable.data() : nullptr);
+    trans->set_byte_enable_length(holes ? hi - lo : 0);
+    trans->set_response_status(tlm::TLM_INCOMPLETE_RESPONSE);
+
+    /* No packet, gem5 was answered when the writes were merged */
+    Gem5Extension* extension = new Gem5Extension(nullptr);
+    extension->setCoreID(socket_id);
+    extension->setPostedSlot(slot);
+    trans->set_auto_extension(extension);
+
+    buffer.valid = false;
+    if (buffer.timeout->scheduled()) {
+        owner.deschedule(*buffer.timeout);
+    }
+    sendBeginReq(trans, socket_id, sc_core::SC_ZERO_TIME);
+    return true;
+}
+
+void
+SCSlavePort::combineTimeout(uint32_t socket_id)
+{
+    HostTimeScope host_time(HOST_TIME_SLAVE_PORT);
+    CAUGHT_UP;
+    if (!flushCombine(socket_id, false)) {
+        scheduleEvent(*combineBuffers[socket_id].timeout,
+                      gem5::curTick() + combineWindow);
+    }
+}
+
+void
+SCSlavePort::respondCombined()
+{
+    HostTimeScope host_time(HOST_TIME_SLAVE_PORT);
+    CAUGHT_UP;
+    for (auto packet : combinedPackets) {
+        respondEarly(packet);
+    }
+    combinedPackets.clear();
+}
+
+void
+SCSlavePort::initFetchBypass()
+{
+    const FetchBypassConfig& config = transactor_multi->getFetchBypass();
+    if (!config.enabled) {
+        return;
+    }
+    fetchLatency = config.latency.value();
+    fetchDmi.resize(transactor_multi->getSocketNum());
+    fetchDmiValid.assign(transactor_multi->getSocketNum(), false);
+    for (auto& core : cpu_port_map) {
+        if (!config.cores.empty() &&
+            std::find(config.cores.begin(), config.cores.end(),
+                      core.first) == config.cores.end()) {
+            continue;
+        }
+        for (auto id : core.second) {
+            if (instRequestors.count(id)) {
+                fetchBypassRequestors.insert(id);
+            }
+        }
+    }
+    if (fetchBypassRequestors.empty()) {
+        SC_REPORT_WARNING("SCSlavePort",
+                          "Fetch bypass enabled but no fetch requestors");
+    }
+}
+
+bool
+SCSlavePort::fetchBypass(gem5::PacketPtr packet)
+{
+    gem5::Addr addr = packet->getAddr();
+    gem5::Addr last = addr + packet->getSize() - 1;
+    uint32_t socket_id = getSocketId(packet);
+
+    tlm::tlm_generic_payload *trans = getSyncPayload(packet, socket_id);
+    tlm::tlm_dmi& dmi = fetchDmi[socket_id];
+    if (!fetchDmiValid[socket_id] || addr < dmi.get_start_address() ||
+        last > dmi.get_end_address()) {
+        /* A refusal also tells the range it applies to, so a target
+         * without DMI is not asked on every fetch */
+        dmi.init();
+        transactor_multi->sockets[socket_id]->get_direct_mem_ptr(*trans, dmi);
+        fetchDmiValid[socket_id] = true;
+    }
+    if (dmi.is_read_allowed() && addr >= dmi.get_start_address() &&
+        last <= dmi.get_end_address()) {
+        std::memcpy(packet->getPtr<uint8_t>(),
+                    dmi.get_dmi_ptr() + (addr - dmi.get_start_address()),
+                    packet->getSize());
+    } else {
+        unsigned bytes =
+            transactor_multi->sockets[socket_id]->transport_dbg(*trans);
+        if (bytes != trans->get_data_length()) {
+            SC_REPORT_FATAL("SCSlavePort",
+                            "debug transport was not completed");
+        }
+    }
+    putSyncPayload(trans);
+    functionalPostedWrites(packet);
+    snoopAgents(packet, true);
+
+    /* Answer after the fixed latency, never from within recvTimingReq */
+    packet->makeResponse();
+    packet->payloadDelay = 0;
+    packet->headerDelay = 0;
+    gem5::Tick when = gem5::curTick() + fetchLatency;
+    fetchResponses.emplace_back(when, packet);
+    if (!fetchRespondEvent.scheduled()) {
+        scheduleEvent(fetchRespondEvent, when);
+    }
     return true;
 }
 
+void
+SCSlavePort::respondFetches()
+{
+    HostTimeScope host_time(HOST_TIME_SLAVE_PORT);
+    CAUGHT_UP;
+    while (!fetchResponses.empty() &&
+           fetchResponses.front().first <= gem5::curTick()) {
+        sendPostedResponse(fetchResponses.front().second);
+        fetchResponses.pop_front();
+    }
+    if (!fetchResponses.empty()) {
+        scheduleEvent(fetchRespondEvent, fetchResponses.front().first);
+    }
+}
+
+void
+SCSlavePort::invalidate_direct_mem_ptr(int socket_id, sc_dt::uint64 start,
+                                       sc_dt::uint64 end)
+{
+    if (fetchDmi.empty()) {
+        return;
+    }
+    tlm::tlm_dmi& dmi = fetchDmi[socket_id];
+    if (fetchDmiValid[socket_id] && start <= dmi.get_end_address() &&
+        end >= dmi.get_start_address()) {
+        fetchDmiValid[socket_id] = false;
+    }
+}
+
+SCSlavePortSocketStats::SCSlavePortSocketStats(
+    gem5::statistics::Group *parent, const std::string &name)
+    : gem5::statistics::Group(parent, name.c_str()),
+      ADD_STAT(acceptLatency, gem5::statistics::units::Tick::get(),
+               "Ticks from receiving a request until END_REQ"),
+      ADD_STAT(serviceLatency, gem5::statistics::units::Tick::get(),
+               "Ticks from END_REQ until BEGIN_RESP"),
+      ADD_STAT(respRetryDelay, gem5::statistics::units::Tick::get(),
+               "Ticks from BEGIN_RESP until gem5 took the response")
+{
+    acceptLatency.init(16);
+    serviceLatency.init(16);
+    respRetryDelay.init(16);
+}
+
+void
+SCSlavePort::initStats(uint32_t sockets)
+{
+    for (uint32_t i = 0; i < sockets; i++) {
+        socketStats.emplace_back(new SCSlavePortSocketStats(&owner,
+            "tlmSocket" + std::to_string(i)));
+    }
+}
+
+SCSlavePortSocketStats*
+SCSlavePort::getSocketStats(tlm::tlm_generic_payload& trans)
+{
+    uint32_t socket_id = Gem5Extension::getExtension(trans).getCoreID();
+    return socket_id < socketStats.size() ? socketStats[socket_id].get()
+                                          : nullptr;
+}
+
+void
+SCSlavePort::sampleEndReq(tlm::tlm_generic_payload& trans)
+{
+    auto& timestamps = Gem5Extension::getExtension(trans).timestamps;
+    if (timestamps.endReq != gem5::MaxTick) {
+        return;
+    }
+    timestamps.endReq = gem5::curTick();
+    auto stats = getSocketStats(trans);
+    /* Combined writes have no request of their own */
+    if (stats && timestamps.request != gem5::MaxTick) {
+        stats->acceptLatency.sample(timestamps.endReq - timestamps.request);
+    }
+    auto trace = ChromeTrace::get();
+    if (trace && timestamps.request != gem5::MaxTick) {
+        uint32_t socket_id = Gem5Extension::getExtension(trans).getCoreID();
+        trace->span(getTracePid(*trace), 2 * socket_id, "request",
+                    timestamps.request / gem5::sim_clock::as_int::ps,
+                    timestamps.endReq / gem5::sim_clock::as_int::ps,
+                    trans.get_address());
+    }
+}
+
+void
+SCSlavePort::sampleBeginResp(tlm::tlm_generic_payload& trans)
+{
+    /* A BEGIN_RESP without END_REQ implies it */
+    sampleEndReq(trans);
+    auto& timestamps = Gem5Extension::getExtension(trans).timestamps;
+    timestamps.beginResp = gem5::curTick();
+    if (auto stats = getSocketStats(trans)) {
+        stats->serviceLatency.sample(timestamps.beginResp -
+                                     timestamps.endReq);
+    }
+    if (auto trace = ChromeTrace::get()) {
+        uint32_t socket_id = Gem5Extension::getExtension(trans).getCoreID();
+        trace->asyncSpan(getTracePid(*trace), 2 * socket_id, "service",
+                         timestamps.endReq / gem5::sim_clock::as_int::ps,
+                         timestamps.beginResp / gem5::sim_clock::as_int::ps,
+                         trans.get_address());
+    }
+}
+
+void
+SCSlavePort::sampleRespSent(tlm::tlm_generic_payload& trans)
+{
+    auto& timestamps = Gem5Extension::getExtension(trans).timestamps;
+    auto stats = getSocketStats(trans);
+    if (stats && timestamps.beginResp != gem5::MaxTick) {
+        stats->respRetryDelay.sample(gem5::curTick() - timestamps.beginResp);
+    }
+    auto trace = ChromeTrace::get();
+    if (trace && timestamps.beginResp != gem5::MaxTick) {
+        uint32_t socket_id = Gem5Extension::getExtension(trans).getCoreID();
+        trace->span(getTracePid(*trace), 2 * socket_id + 1, "response",
+                    timestamps.beginResp / gem5::sim_clock::as_int::ps,
+                    gem5::curTick() / gem5::sim_clock::as_int::ps,
+                    trans.get_address());
+    }
+}
+
+uint32_t
+SCSlavePort::getTracePid(ChromeTrace& trace)
+{
+    if (tracePid == 0) {
+        tracePid = trace.addProcess(name());
+        uint32_t sockets = transactor_multi != nullptr
+                               ? transactor_multi->getSocketNum() : 1;
+        for (uint32_t i = 0; i < sockets; i++) {
+            trace.nameTrack(tracePid, 2 * i,
+                            "socket" + std::to_string(i) + " request");
+            trace.nameTrack(tracePid, 2 * i + 1,
+                            "socket" + std::to_string(i) + " response");
+        }
+    }
+    return tracePid;
+}
+
+void
+SCSlavePort::scheduleEvent(gem5::Event& event, gem5::Tick when)
+{
+    owner.wakeupEventQueue(when);
+    owner.schedule(event, when);
+}
+
 void
 SCSlavePort::pec(
     PayloadEvent<SCSlavePort> * pe,
     tlm::tlm_generic_payload& trans,
     const tlm::tlm_phase& phase)
 {
+    HostTimeScope host_time(HOST_TIME_SLAVE_PORT);
     sc_time delay;
 
     if (phase == tlm::END_REQ ||
@@ -349,6 +1091,7 @@ SCSlavePort::pec(
               && phase == tlm::BEGIN_RESP) ||
               (&trans == blockingRequest && phase == tlm::BEGIN_RESP)
               ) {
+        sampleEndReq(trans);
         // system port is blocked, send retry
         if (&trans == blockingRequest && usingGem5Cache){
             sc_assert(&trans == blockingRequest);
@@ -371,6 +1114,24 @@ SCSlavePort::pec(
                 sendRetryReq();
             }
         }
+        if (Gem5Extension::getExtension(trans).isPosted()) {
+            respondPosted(trans);
+        }
+    }
+    if (phase != tlm::END_REQ &&
+        Gem5Extension::getExtension(trans).isPosted()) {
+        /* The target finished a posted write (BEGIN_RESP, or END_RESP if it
+         * completed immediately), gem5 is answered at the latest now */
+        CAUGHT_UP;
+        respondPosted(trans);
+        if (phase == tlm::BEGIN_RESP) {
+            sampleBeginResp(trans);
+            sendEndResp(trans, Gem5Extension::getExtension(trans).getCoreID());
+        }
+        freePostedWrite(trans);
+        trans.release();
+        delete pe;
+        return;
     }
     if (phase == tlm::BEGIN_RESP)
     {
@@ -387,6 +1148,8 @@ SCSlavePort::pec(
         }
 
         bool need_retry = false;
+        finishAmo(trans, packet);
+        sampleBeginResp(trans);
 
         // If there is another gem5 model under the receiver side, and already
         // make a response packet back, we can simply send it back. Otherwise,
@@ -408,6 +1171,7 @@ SCSlavePort::pec(
                                                         pktType::Response);
             }
         } else {
+            sampleRespSent(trans);
             if (phase == tlm::BEGIN_RESP) {
                 /* Send END_RESP and we're finished: */
                 tlm::tlm_phase fw_phase = tlm::END_RESP;
@@ -432,6 +1196,7 @@ SCSlavePort::pec(
 void
 SCSlavePort::recvRespRetry()
 {
+    HostTimeScope host_time(HOST_TIME_SLAVE_PORT);
     CAUGHT_UP;
 
     /* Retry a response */
@@ -457,6 +1222,7 @@ SCSlavePort::recvRespRetry()
         bool need_retry = !sendTimingResp(packet);
 
         sc_assert(!need_retry);
+        sampleRespSent(*trans);
 
         sc_core::sc_time delay = sc_core::SC_ZERO_TIME;
         tlm::tlm_phase phase = tlm::END_RESP;
@@ -474,6 +1240,12 @@ SCSlavePort::recvRespRetry()
         trans->release();
         response = blk_pkt_helper->getBlockingResponse();
     }
+
+    /* Early responses of posted writes */
+    while (!postedResponses.empty() &&
+           sendTimingResp(postedResponses.front())) {
+        postedResponses.pop_front();
+    }
 }
 
 tlm::tlm_sync_enum
@@ -481,6 +1253,7 @@ SCSlavePort::nb_transport_bw(tlm::tlm_generic_payload& trans,
     tlm::tlm_phase& phase,
     sc_core::sc_time& delay)
 {
+    HostTimeScope host_time(HOST_TIME_SLAVE_PORT);
     PayloadEvent<SCSlavePort> * pe;
     pe = new PayloadEvent<SCSlavePort>(*this, &SCSlavePort::pec, "PE");
     pe->notify(trans, phase, delay);
@@ -495,7 +1268,12 @@ SCSlavePort::SCSlavePort(const std::string &name_,
     needToSendRequestRetry(false),
     blockingResponse(NULL),
     transactor(nullptr),
-    blk_pkt_helper(new BlockingPacketHelper())
+    transactor_multi(nullptr),
+    blk_pkt_helper(new BlockingPacketHelper()),
+    syncExtension(nullptr),
+    combineRespondEvent([this]{ respondCombined(); },
+                        name_ + ".combineRespond"),
+    fetchRespondEvent([this]{ respondFetches(); }, name_ + ".fetchRespond")
 {
 
 }
@@ -519,14 +1297,45 @@ SCSlavePort::bindToTransactor(Gem5SlaveTransactor_Multi* transactor)
     this->transactor_multi = transactor;
     for (int i = 0; i < transactor->getSocketNum(); i++){
         transactor->sockets[i].register_nb_transport_bw(this,
-                                                &SCSlavePort::nb_transport_bw);
+                                &SCSlavePort::nb_transport_bw_tagged, i);
+        transactor->sockets[i].register_invalidate_direct_mem_ptr(this,
+                                &SCSlavePort::invalidate_direct_mem_ptr, i);
     }
     this->usingGem5Cache = transactor->isUsingGem5Cache(); //TODO
+    this->postedWrites.resize(transactor->getPostedWrites());
+    if (transactor->getCombineLineBytes() != 0) {
+        if (this->postedWrites.empty()) {
+            SC_REPORT_FATAL("SCSlavePort",
+                            "Write combining requires posted writes");
+        }
+        combineLineBytes = transactor->getCombineLineBytes();
+        combineWindow = transactor->getCombineWindow().value();
+        combineBuffers.resize(transactor->getSocketNum());
+        for (uint32_t i = 0; i < combineBuffers.size(); i++) {
+            auto& buffer = combineBuffers[i];
+            buffer.data.resize(combineLineBytes);
+            buffer.byteEnable.resize(combineLineBytes);
+            buffer.timeout.reset(new gem5::EventFunctionWrapper(
+                [this, i]{ combineTimeout(i); },
+                name() + ".combineTimeout" + std::to_string(i)));
+        }
+    }
     // initiate blocking packet helper
     this->blk_pkt_helper->setUsingGem5Cache(
                                             transactor->isUsingGem5Cache());
     this->initSocketMap();
-    this->blk_pkt_helper->init(this->socket_map.size());
+    this->initFetchBypass();
+    this->initStats(transactor->getSocketNum());
+    if (!transactor->getRequestCapture().empty()) {
+        capture.reset(new ReqTraceWriter);
+        if (!capture->open(transactor->getRequestCapture())) {
+            SC_REPORT_FATAL("SCSlavePort",
+                            "Can't create the request capture file");
+        }
+    }
+    // with address interleaving any socket can carry requests of any core
+    this->blk_pkt_helper->init(std::max<uint32_t>(this->socket_map.size(),
+                                                  transactor->getSocketNum()));
     // print the socket map , TODO: can be removed
     std::cout << "Print the socket port map" << std::endl;
     auto iter = this->socket_map.begin();
@@ -554,7 +1363,26 @@ SCSlavePortHandler::getExternalPort(const std::string &name,
     return port;
 }
 
+uint32_t SCSlavePort::getSocketId(gem5::PacketPtr packet)
+{
+    uint32_t socket_id;
+    bool core = findCoreSocket(packet->requestorId(), socket_id);
+    /* System requestors stay on their socket below firstSocket */
+    if (core && transactor_multi != nullptr &&
+        transactor_multi->isInterleaving()) {
+        return transactor_multi->getInterleavedSocket(packet->getAddr());
+    }
+    return socket_id;
+}
+
 uint32_t SCSlavePort::getSocketId(gem5::RequestorID id)
+{
+    uint32_t socket_id;
+    findCoreSocket(id, socket_id);
+    return socket_id;
+}
+
+bool SCSlavePort::findCoreSocket(gem5::RequestorID id, uint32_t& socket_id)
 {
     // TODO: different cpu can used same port is set as a cpu cluster
     for (auto it = socket_map.begin();it != socket_map.end(); it++){
@@ -562,17 +1390,19 @@ uint32_t SCSlavePort::getSocketId(gem5::RequestorID id)
         if (it_find != it->second.end()){
             if (this->usingGem5Cache){
                 // socket0 is used for system port
-                return it->first + 1;
+                socket_id = it->first + 1;
             }else {
-                return it->first;
+                socket_id = it->first;
             }
+            return true;
         }
     }
     /* Packet from system requestor like functional or write back will use this
      * socket. If not use gem5 cache, only functional packet will using this
      * port. We can using the first socket to transfer the packet.
      */
-    return 0;
+    socket_id = 0;
+    return false;
 }
 
 void SCSlavePort::
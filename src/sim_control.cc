@@ -39,9 +39,13 @@
  *
  */
 
+#include <cstdio>
 #include <systemc>
 #include <tlm>
 
+#include "chrome_trace.h"
+#include "cpu/base.hh"
+#include "host_time.h"
 #include "sc_master_port.hh"
 #include "sc_slave_port.hh"
 #include "sim/cxx_config_ini.hh"
@@ -64,7 +68,9 @@ Gem5SimControl::Gem5SimControl(sc_core::sc_module_name name,
                                uint64_t simulationEnd,
                                const std::string& gem5DebugFlags)
   : Gem5SystemC::Module(name),
-    simulationEnd(simulationEnd)
+    simulationEnd(simulationEnd),
+    progressEvent([this]{ reportProgress(); }, "Gem5SimControl.progress",
+                  false, gem5::Event::Progress_Event_Pri)
 {
     SC_THREAD(run);
     std::cout << ">>>> GEM5SimControl init" << std::endl;
@@ -160,17 +166,38 @@ Gem5SimControl::run()
 
     gem5::GlobalSimLoopExitEvent *exit_event = NULL;
 
+    gem5::Tick start_tick = gem5::curTick();
+    HostTime::get().start();
+    if (progressInterval != 0) {
+        lastProgress = {start_tick, 0.0, countTransactions(),
+                        double(gem5::BaseCPU::numSimulatedInsts())};
+        gem5::getEventQueue(0)->schedule(&progressEvent,
+                                         start_tick + progressInterval);
+    }
+
     if (simulationEnd == 0) {
         exit_event = simulate();
     } else {
         exit_event = simulate(simulationEnd);
     }
 
+    if (progressEvent.scheduled()) {
+        gem5::getEventQueue(0)->deschedule(&progressEvent);
+    }
+
     std::cerr << "Exit at tick " << gem5::curTick()
               << ", cause: " << exit_event->getCause() << '\n';
+    HostTime::get().report(std::cerr, gem5::curTick() - start_tick);
 
     gem5::getEventQueue(0)->dump();
 
+    if (!ChromeTrace::close()) {
+        std::cerr << "Writing the transaction trace failed\n";
+    }
+    for (auto& port : slavePorts) {
+        port.second->closeCapture();
+    }
+
     // notify callback
     afterSimulate();
 
@@ -179,6 +206,49 @@ Gem5SimControl::run()
 #endif
 }
 
+void
+Gem5SimControl::reportProgress()
+{
+    gem5::Tick now = gem5::curTick();
+    double host = HostTime::get().elapsed();
+    uint64_t transactions = countTransactions();
+    double insts = gem5::BaseCPU::numSimulatedInsts();
+
+    double interval = host - lastProgress.hostSeconds;
+    auto rate = [interval](double count) {
+        return interval > 0 ? count / interval : 0.0;
+    };
+    char line[256];
+    int len = std::snprintf(line, sizeof(line),
+        "Progress: tick %llu (%.6f s simulated), host %.1f s, "
+        "%.4g ticks/s, %.4g transactions/s",
+        (unsigned long long)now, double(now) / gem5::sim_clock::Frequency,
+        host, rate(now - lastProgress.tick),
+        rate(transactions - lastProgress.transactions));
+    if (gem5::BaseCPU::numSimulatedCPUs() > 0 && len > 0 &&
+        len < int(sizeof(line))) {
+        std::snprintf(line + len, sizeof(line) - len, ", %.4g insts/s",
+                      rate(insts - lastProgress.insts));
+    }
+    std::cerr << line << '\n';
+
+    lastProgress = {now, host, transactions, insts};
+    gem5::getEventQueue(0)->schedule(&progressEvent, now + progressInterval);
+}
+
+uint64_t
+Gem5SimControl::countTransactions() const
+{
+    uint64_t transactions = 0;
+    for (auto& port : slavePorts) {
+        transactions += port.second->getTransactions();
+    }
+    for (auto& port : masterPorts) {
+        transactions += port.second->getTransactions();
+    }
+    return transactions;
+}
+
 void
 Gem5SimControl::registerSlavePort(const std::string& name, SCSlavePort* port)
 {
@@ -212,6 +282,7 @@ Gem5SimControl::getSlavePort(const std::string& name)
     }
     // Update the core <-> requestor id infomation to slave port
     slavePorts.at(name)->updateCorePortMap(this->cpuPorts);
+    slavePorts.at(name)->setInstRequestors(this->instRequestors);
     return slavePorts.at(name);
 }
 
@@ -238,6 +309,7 @@ void Gem5SimControl::initCoreInfo(gem5::CxxConfigManager* cxx_manager) {
 
         this->addCoreID(core_name, inst_id);
         this->addCoreID(core_name, data_id);
+        this->instRequestors.insert(inst_id);
     }
 }
 
@@ -66,6 +66,7 @@ Gem5SlaveTransactor_Multi::Gem5SlaveTransactor_Multi(sc_core::sc_module_name nam
     : sc_core::sc_module(name),
       sockets(portName.c_str()),
       sim_control("sim_control"),
+      snoop_sockets("snoop_sockets"),
       portName(portName),
       socket_num(socket_num)
 {
@@ -91,6 +92,62 @@ init_port_type* Gem5SlaveTransactor_Multi::create_socket()
     return socket_p;
 }
 
+void
+Gem5SlaveTransactor_Multi::setInterleaving(const InterleaveConfig& config)
+{
+    if (config.firstSocket >= socket_num) {
+        SC_REPORT_FATAL(name(), "No sockets left to interleave over");
+    }
+    if (config.firstSocket == 0 && isUsingGem5Cache()) {
+        // socket 0 carries the system port, see SCSlavePort::sendBeginReq
+        SC_REPORT_FATAL(name(), "Socket 0 is the system port's, "
+                        "interleave from socket 1 on");
+    }
+    interleaving = true;
+    interleaveConfig = config;
+    interleaveWays = socket_num - config.firstSocket;
+    interleaveHashBits = 0;
+    while ((1u << interleaveHashBits) < interleaveWays) {
+        interleaveHashBits++;
+    }
+}
+
+void
+Gem5SlaveTransactor_Multi::setWriteCombining(unsigned lineBytes,
+                                             const sc_core::sc_time& window)
+{
+    if (lineBytes == 0 || (lineBytes & (lineBytes - 1)) != 0) {
+        SC_REPORT_FATAL(name(), "Write combining line must be a power of 2");
+    }
+    combineLineBytes = lineBytes;
+    combineWindow = window;
+}
+
+void
+Gem5SlaveTransactor_Multi::setSnoopAgents(uint32_t agents, unsigned lineBytes)
+{
+    if (agents == 0 || agents > 32) {
+        SC_REPORT_FATAL(name(), "Between 1 and 32 snoop agents supported");
+    }
+    snoop_sockets.init(agents);
+    snoopFilter = SnoopFilter(lineBytes);
+}
+
+uint32_t
+Gem5SlaveTransactor_Multi::getInterleavedSocket(uint64_t addr) const
+{
+    uint64_t index = addr >> interleaveConfig.granularityBits;
+    if (interleaveConfig.xorHash && interleaveHashBits > 0) {
+        uint64_t mask = (uint64_t(1) << interleaveHashBits) - 1;
+        uint64_t hash = 0;
+        for (; index; index >>= interleaveHashBits) {
+            hash ^= index & mask;
+        }
+        index = hash;
+    }
+    return interleaveConfig.firstSocket + index % interleaveWays;
+}
+
 std::string Gem5SlaveTransactor_Multi::getNameForNewSocket(std::string name)
 {
     assert(count < socket_num);
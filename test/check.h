@@ -0,0 +1,42 @@
+/**
+ * @file check.h
+ * @brief Minimal check harness shared by the tests
+ *
+ * CHECK reports a failed condition with its location and counts it, the
+ * test goes on. checkResult prints the summary and gives the exit code.
+ * Each test is a single translation unit, so the counter lives here.
+ */
+
+#ifndef TEST_CHECK_H
+#define TEST_CHECK_H
+
+#include <iostream>
+
+namespace
+{
+
+int failures = 0;
+
+/** Exit code of a test: 0 if all checks held */
+int
+checkResult(const char* test)
+{
+    if (failures) {
+        std::cerr << failures << " check(s) failed\n";
+        return 1;
+    }
+    std::cout << test << " passed\n";
+    return 0;
+}
+
+} // anonymous namespace
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": " #cond "\n"; \
+            failures++; \
+        } \
+    } while (0)
+
+#endif
@@ -0,0 +1,108 @@
+/**
+ * @file dram_timing_test.cc
+ * @brief Bandwidth and row-buffer behaviour of DramTiming
+ *
+ * Sequential and random streams of 64 byte reads are timed by a default
+ * (DDR4-2400 x64) DramTiming. A sequential stream must reach the data bus
+ * rate of 64 B per tBURST, about 19.2 GB/s, and hit the open row on all
+ * but one burst per row. A random stream conflicts on almost every access
+ * and is limited by tRRD/tFAW and the bank cycle to about 5 GB/s. Paced
+ * over several tREFI, refreshes stall accesses and close the rows.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <systemc>
+
+#include "dram_timing.h"
+
+#include "check.h"
+
+using namespace Gem5SystemC;
+
+namespace
+{
+
+constexpr unsigned burstBytes = 64;
+constexpr unsigned accesses = 1 << 16;
+
+enum Pattern { SEQUENTIAL, RANDOM };
+
+/**
+ * Time a stream of reads, all ready at time zero or, if paced, arriving
+ * one per tBURST. Returns the bandwidth in GB/s.
+ */
+double
+stream(DramTiming& dram, Pattern pattern, bool paced)
+{
+    const DramTimingConfig config;
+    std::mt19937_64 rng(1);
+    sc_core::sc_time end = sc_core::SC_ZERO_TIME;
+    for (unsigned i = 0; i < accesses; i++) {
+        uint64_t addr = pattern == SEQUENTIAL
+            ? uint64_t(i) * burstBytes
+            : (rng() % (uint64_t(1) << 32)) & ~uint64_t(burstBytes - 1);
+        sc_core::sc_time arrival = paced ? config.tBURST * double(i)
+                                         : sc_core::SC_ZERO_TIME;
+        end = std::max(end, dram.access(addr, burstBytes, false, arrival));
+    }
+    double gbps = double(accesses) * burstBytes / end.to_seconds() / 1e9;
+    const DramTimingStats& s = dram.stats();
+    std::cout << (pattern == SEQUENTIAL ? "sequential" : "random")
+              << (paced ? " paced" : "") << ": " << gbps << " GB/s, "
+              << s.row_hits << " row hits, " << s.row_misses << " misses, "
+              << s.row_conflicts << " conflicts, " << s.refresh_stalls
+              << " refresh stalls\n";
+    return gbps;
+}
+
+} // anonymous namespace
+
+int sc_main(int, char*[])
+{
+    const DramTimingConfig config;
+    const double peak = burstBytes / config.tBURST.to_seconds() / 1e9;
+    const uint64_t rows = uint64_t(accesses) * burstBytes / config.row_size;
+
+    {
+        // one activate per row, the data bus is never idle
+        DramTiming dram("sequential");
+        double gbps = stream(dram, SEQUENTIAL, false);
+        const DramTimingStats& s = dram.stats();
+        CHECK(gbps > 0.98 * peak && gbps <= peak);
+        CHECK(gbps > 18.8 && gbps < 19.3);
+        CHECK(s.reads == accesses && s.bytes == accesses * burstBytes);
+        CHECK(s.row_misses + s.row_conflicts == rows);
+        CHECK(s.row_hits == accesses - rows);
+        CHECK(s.refresh_stalls == 0);
+    }
+    {
+        // a different row nearly every time, bound by activates
+        DramTiming dram("random");
+        double gbps = stream(dram, RANDOM, false);
+        const DramTimingStats& s = dram.stats();
+        CHECK(gbps > 4.5 && gbps < 5.5);
+        CHECK(s.row_hits < accesses / 100);
+        CHECK(s.row_conflicts > accesses - accesses / 100);
+    }
+    {
+        // over ~28 tREFI: refreshes stall and reopen rows, the backlog
+        // they build is drained at the bus rate
+        DramTiming dram("sequential_paced");
+        double gbps = stream(dram, SEQUENTIAL, true);
+        const DramTimingStats& s = dram.stats();
+        CHECK(gbps > 0.98 * peak && gbps <= peak);
+        CHECK(s.refresh_stalls > 0);
+        CHECK(s.row_misses > config.banks);
+    }
+    {
+        DramTiming dram("random_paced");
+        double gbps = stream(dram, RANDOM, true);
+        CHECK(gbps > 4.5 && gbps < 5.5);
+        CHECK(dram.stats().refresh_stalls > 0);
+    }
+
+    return checkResult("dram_timing_test");
+}
@@ -0,0 +1,116 @@
+/**
+ * @file txn_router_test.cc
+ * @brief Routing of blocking and debug accesses through TxnRouter
+ *
+ * Debug accesses outside the memory window take the default route to
+ * isock_bus, and blocking accesses keep the response status of the target.
+ */
+
+#include <tlm_utils/simple_initiator_socket.h>
+#include <tlm_utils/simple_target_socket.h>
+
+#include <iostream>
+#include <systemc>
+#include <tlm>
+
+#include "txn_router.h"
+
+#include "check.h"
+
+using namespace Gem5SystemC;
+
+namespace
+{
+
+/** Counts the accesses it gets, answers blocking ones with status */
+struct CountingTarget : sc_core::sc_module
+{
+    tlm_utils::simple_target_socket<CountingTarget> tsock;
+    unsigned debug_accesses = 0;
+    unsigned blocking_accesses = 0;
+    tlm::tlm_response_status status = tlm::TLM_INCOMPLETE_RESPONSE;
+
+    CountingTarget(sc_core::sc_module_name)
+        : tsock("tsock")
+    {
+        tsock.register_b_transport(this, &CountingTarget::b_transport);
+        tsock.register_transport_dbg(this, &CountingTarget::transport_dbg);
+    }
+
+    void b_transport(tlm::tlm_generic_payload& trans, sc_core::sc_time&)
+    {
+        blocking_accesses++;
+        trans.set_response_status(status);
+    }
+
+    unsigned transport_dbg(tlm::tlm_generic_payload& trans)
+    {
+        debug_accesses++;
+        return trans.get_data_length();
+    }
+};
+
+struct Initiator : sc_core::sc_module
+{
+    tlm_utils::simple_initiator_socket<Initiator> isock;
+
+    Initiator(sc_core::sc_module_name)
+        : isock("isock")
+    {}
+};
+
+constexpr uint64_t memStart = 0x80000000;
+constexpr uint64_t memSize = 0x10000000;
+
+} // anonymous namespace
+
+int sc_main(int, char*[])
+{
+    Initiator initiator("initiator");
+    TxnRouter router("router", memStart, memSize, false);
+    CountingTarget mem("mem");
+    CountingTarget bus("bus");
+    initiator.isock.bind(router.tsock);
+    router.isock_mem.bind(mem.tsock);
+    router.isock_bus.bind(bus.tsock);
+    sc_core::sc_start(sc_core::SC_ZERO_TIME);
+
+    unsigned char data[8] = {};
+    tlm::tlm_generic_payload trans;
+    trans.set_data_ptr(data);
+    trans.set_data_length(sizeof(data));
+    trans.set_streaming_width(sizeof(data));
+    trans.set_command(tlm::TLM_READ_COMMAND);
+
+    // debug accesses outside the memory window go to isock_bus
+    trans.set_address(0x10000000);
+    CHECK(initiator.isock->transport_dbg(trans) == sizeof(data));
+    CHECK(bus.debug_accesses == 1);
+
+    // and so do those inside it, memory is reached through the bus
+    trans.set_address(memStart + 0x100);
+    CHECK(initiator.isock->transport_dbg(trans) == sizeof(data));
+    CHECK(bus.debug_accesses == 2);
+    CHECK(mem.debug_accesses == 0);
+
+    // an untouched status becomes TLM_OK_RESPONSE
+    sc_core::sc_time delay = sc_core::SC_ZERO_TIME;
+    trans.set_response_status(tlm::TLM_INCOMPLETE_RESPONSE);
+    initiator.isock->b_transport(trans, delay);
+    CHECK(mem.blocking_accesses == 1);
+    CHECK(trans.get_response_status() == tlm::TLM_OK_RESPONSE);
+
+    // an error of the target is kept
+    mem.status = tlm::TLM_GENERIC_ERROR_RESPONSE;
+    trans.set_response_status(tlm::TLM_INCOMPLETE_RESPONSE);
+    initiator.isock->b_transport(trans, delay);
+    CHECK(trans.get_response_status() == tlm::TLM_GENERIC_ERROR_RESPONSE);
+
+    // blocking accesses outside the window take the default route too
+    bus.status = tlm::TLM_OK_RESPONSE;
+    trans.set_address(0x10000000);
+    initiator.isock->b_transport(trans, delay);
+    CHECK(bus.blocking_accesses == 1);
+
+    return checkResult("txn_router_test");
+}
@@ -0,0 +1,32 @@
+/**
+ * @file req_trace_decode.cc
+ * @brief Offline decoder for SCSlavePort request captures
+ *
+ * Usage: req_trace_decode <file.reqtrace>
+ *
+ * Prints one line per request: tick, socket, requestor, command, address,
+ * size.
+ */
+
+#include <fstream>
+#include <iostream>
+
+#include "req_trace.h"
+
+int main(int argc, char** argv)
+{
+    if (argc != 2) {
+        std::cerr << "Usage: " << argv[0] << " <file.reqtrace>\n";
+        return 1;
+    }
+    std::ifstream in(argv[1], std::ios::binary);
+    if (!in) {
+        std::cerr << "Can't open trace file: " << argv[1] << '\n';
+        return 1;
+    }
+    if (!Gem5SystemC::ReqTraceReader::decode(in, std::cout)) {
+        std::cerr << "Malformed trace file: " << argv[1] << '\n';
+        return 1;
+    }
+    return 0;
+}
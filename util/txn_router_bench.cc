@@ -0,0 +1,152 @@
+/**
+ * @file txn_router_bench.cc
+ * @brief Host cost per transaction of the TxnRouter timing path
+ *
+ * Usage: txn_router_bench [transactions]
+ *
+ * An initiator thread pushes transactions one after the other through the
+ * non-blocking path of a TxnRouter (BEGIN_REQ, END_REQ, BEGIN_RESP,
+ * END_RESP) to a memory answering b_transport, and the host time of the
+ * whole run is divided by the number of transactions. The bench only uses
+ * the constructor and the sockets of the router, so the same source can be
+ * built against older revisions of txn_router.h to compare them, e.g. the
+ * router before its execution was driven by a PEQ:
+ *
+ *   git archive f9ec9d1^ include | tar -x -C /tmp/old
+ *   c++ -O2 -std=c++17 -I/tmp/old/include util/txn_router_bench.cc -lsystemc
+ */
+
+#include <tlm_utils/simple_initiator_socket.h>
+#include <tlm_utils/simple_target_socket.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <systemc>
+#include <tlm>
+
+#include "txn_router.h"
+
+using namespace Gem5SystemC;
+
+namespace
+{
+
+constexpr uint64_t memStart = 0x80000000;
+constexpr uint64_t memSize = 0x10000000;
+
+/** The router acquires and releases the payload, nothing to free */
+struct StaticMM : tlm::tlm_mm_interface
+{
+    void free(tlm::tlm_generic_payload*) override {}
+};
+
+struct Memory : sc_core::sc_module
+{
+    tlm_utils::simple_target_socket<Memory> tsock;
+
+    Memory(sc_core::sc_module_name)
+        : tsock("tsock")
+    {
+        tsock.register_b_transport(this, &Memory::b_transport);
+    }
+
+    void b_transport(tlm::tlm_generic_payload& trans, sc_core::sc_time&)
+    {
+        trans.set_response_status(tlm::TLM_OK_RESPONSE);
+    }
+};
+
+struct Initiator : sc_core::sc_module
+{
+    tlm_utils::simple_initiator_socket<Initiator> isock;
+    uint64_t transactions;
+    uint64_t completed = 0;
+
+    SC_HAS_PROCESS(Initiator);
+    Initiator(sc_core::sc_module_name, uint64_t transactions_)
+        : isock("isock"), transactions(transactions_), trans(&mm)
+    {
+        isock.register_nb_transport_bw(this, &Initiator::nb_transport_bw);
+        SC_THREAD(run);
+    }
+
+  private:
+    void run()
+    {
+        unsigned char data[8] = {};
+        for (uint64_t i = 0; i < transactions; i++) {
+            trans.acquire();
+            trans.set_command(i & 1 ? tlm::TLM_WRITE_COMMAND
+                                    : tlm::TLM_READ_COMMAND);
+            trans.set_address(memStart + (i * 64) % memSize);
+            trans.set_data_ptr(data);
+            trans.set_data_length(sizeof(data));
+            trans.set_streaming_width(sizeof(data));
+            trans.set_byte_enable_ptr(nullptr);
+            trans.set_response_status(tlm::TLM_INCOMPLETE_RESPONSE);
+
+            tlm::tlm_phase phase = tlm::BEGIN_REQ;
+            sc_core::sc_time delay = sc_core::SC_ZERO_TIME;
+            auto status = isock->nb_transport_fw(trans, phase, delay);
+            if (status == tlm::TLM_UPDATED && phase == tlm::BEGIN_RESP) {
+                wait(delay);
+            } else if (status != tlm::TLM_COMPLETED) {
+                wait(response_event);
+            }
+            if (status != tlm::TLM_COMPLETED) {
+                phase = tlm::END_RESP;
+                delay = sc_core::SC_ZERO_TIME;
+                isock->nb_transport_fw(trans, phase, delay);
+            }
+            trans.release();
+            completed++;
+        }
+    }
+
+    tlm::tlm_sync_enum nb_transport_bw(tlm::tlm_generic_payload&,
+                                       tlm::tlm_phase& phase,
+                                       sc_core::sc_time& delay)
+    {
+        if (phase == tlm::BEGIN_RESP) {
+            response_event.notify(delay);
+        }
+        return tlm::TLM_ACCEPTED;
+    }
+
+    StaticMM mm;
+    tlm::tlm_generic_payload trans;
+    sc_core::sc_event response_event;
+};
+
+} // anonymous namespace
+
+int sc_main(int argc, char* argv[])
+{
+    uint64_t transactions = argc > 1 ? std::strtoull(argv[1], nullptr, 0)
+                                     : 1000000;
+
+    Initiator initiator("initiator", transactions);
+    TxnRouter router("router", memStart, memSize, false);
+    Memory mem("mem");
+    Memory bus("bus");
+    initiator.isock.bind(router.tsock);
+    router.isock_mem.bind(mem.tsock);
+    router.isock_bus.bind(bus.tsock);
+
+    auto start = std::chrono::steady_clock::now();
+    sc_core::sc_start();
+    double seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+
+    if (initiator.completed != transactions) {
+        std::cerr << "only " << initiator.completed << " of " << transactions
+                  << " transactions completed\n";
+        return 1;
+    }
+    std::cout << transactions << " transactions, "
+              << seconds * 1e9 / transactions << " ns per transaction, "
+              << sc_core::sc_time_stamp() << " simulated\n";
+    return 0;
+}
@@ -0,0 +1,31 @@
+/**
+ * @file txn_trace_decode.cc
+ * @brief Offline decoder for TxnRouter trace dumps
+ *
+ * Usage: txn_trace_decode <file.txntrace>
+ *
+ * Prints one line per record: time (ps), event, command, address, length.
+ */
+
+#include <fstream>
+#include <iostream>
+
+#include "txn_trace.h"
+
+int main(int argc, char** argv)
+{
+    if (argc != 2) {
+        std::cerr << "Usage: " << argv[0] << " <file.txntrace>\n";
+        return 1;
+    }
+    std::ifstream in(argv[1], std::ios::binary);
+    if (!in) {
+        std::cerr << "Can't open trace file: " << argv[1] << '\n';
+        return 1;
+    }
+    if (!Gem5SystemC::TxnTraceBuffer::decode(in, std::cout)) {
+        std::cerr << "Malformed trace file: " << argv[1] << '\n';
+        return 1;
+    }
+    return 0;
+}